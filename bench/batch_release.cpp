@@ -0,0 +1,76 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+
+/*
+    Releasing many locks one by one vs. through a lock_set.
+
+    The main thread takes `lock_count` disjoint exclusive locks and drops
+    them, either as a std::vector<exclusive_lock> (one critical section and
+    one wakeup pass per lock) or as a lock_set (one of each for the batch),
+    while background threads keep the locker mutex busy with locks outside
+    the batch.
+*/
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t lock_count = 1000;
+constexpr std::size_t rounds = 200;
+constexpr std::size_t background_count = 3;
+
+template<class Batch>
+double run(Batch batch) {
+    locker locker_;
+    locker_.reserve(lock_count + background_count);
+
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < background_count; ++i) {
+        threads.emplace_back([&, i]() {
+            std::size_t b = lock_count * 10 + i * 10;
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto lock = locker_.lock_exclusive(b, b + 10);
+            }
+        });
+    }
+
+    double total = 0;
+    for (std::size_t r = 0; r < rounds; ++r)
+        total += batch(locker_);
+
+    stop = true;
+    for (auto &&th : threads)
+        th.join();
+
+    return total / rounds;
+}
+
+int main() {
+    auto vector_release = [](locker &locker_) {
+        std::vector<exclusive_lock> locks;
+        for (std::size_t i = 0; i < lock_count; ++i)
+            locks.emplace_back(locker_.lock_exclusive(i * 10, i * 10 + 10));
+
+        auto start = clock_type::now();
+        locks.clear();
+        return std::chrono::duration<double, std::micro>(clock_type::now() - start).count();
+    };
+
+    auto set_release = [](locker &locker_) {
+        lock_set locks;
+        for (std::size_t i = 0; i < lock_count; ++i)
+            locks.insert(locker_.lock_exclusive(i * 10, i * 10 + 10));
+
+        auto start = clock_type::now();
+        locks.unlock_all();
+        return std::chrono::duration<double, std::micro>(clock_type::now() - start).count();
+    };
+
+    std::printf("release of %zu locks, mean of %zu rounds in microseconds\n", lock_count, rounds);
+    std::printf("%-28s %10.1f\n", "std::vector<exclusive_lock>", run(vector_release));
+    std::printf("%-28s %10.1f\n", "lock_set::unlock_all", run(set_release));
+}
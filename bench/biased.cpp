@@ -0,0 +1,64 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+
+/*
+    Shared locks on a hot interval: biased readers vs. the mutex path.
+
+    `thread_count` threads lock the same interval shared over and over.
+    With the same bounds every time the interval becomes hot and the
+    readers only publish themselves in their slots; with bounds rotating
+    among 1000 values no interval gets hot, every lock takes the mutex
+    and updates the node's counter.
+*/
+
+using namespace std::chrono_literals;
+
+constexpr std::size_t thread_counts[] = {1, 4, 16};
+constexpr auto duration = 500ms;
+
+template<bool Hot>
+double run(std::size_t thread_count) {
+    locker locker_;
+
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> operations{0};
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&]() {
+            std::size_t count = 0;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                std::size_t e = Hot ? 64 : 64 + count % 1000;
+                auto lock = locker_.lock_shared(0, e);
+                ++count;
+            }
+
+            operations += count;
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+
+    for (auto &&th : threads)
+        th.join();
+
+    return operations / std::chrono::duration<double>(duration).count();
+}
+
+int main() {
+    std::printf("lock_shared/unlock pairs per second (%u hardware threads)\n", std::thread::hardware_concurrency());
+    std::printf("%8s %14s %14s\n", "threads", "rotating", "hot");
+
+    for (std::size_t thread_count : thread_counts) {
+        double a = run<false>(thread_count);
+        double b = run<true>(thread_count);
+        std::printf("%8zu %14.0f %14.0f\n", thread_count, a, b);
+    }
+}
@@ -0,0 +1,96 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+
+/*
+    Readers streaming over a file while a writer updates records elsewhere.
+
+    Every reader holds shared locks on the last window_size blocks it read,
+    taking the next block and releasing the oldest one. With the blocks next
+    to each other a reader's window is coalesced into a single segment, and
+    the tree holds little more than the segments; with a gap between the
+    blocks every lock stays in the tree. The writer locks records past the
+    readers' blocks, searching that tree.
+*/
+
+using namespace std::chrono_literals;
+
+constexpr std::size_t reader_counts[] = {1, 2, 4};
+constexpr std::size_t window_size = 1000;
+constexpr std::size_t block_size = 16;
+constexpr std::size_t stream_size = std::size_t{1} << 30;
+constexpr auto duration = 500ms;
+
+struct result {
+    double reads;
+    double updates;
+};
+
+template<bool Adjacent>
+result run(std::size_t reader_count) {
+    locker locker_;
+
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> reads{0};
+    std::atomic<std::size_t> updates{0};
+
+    constexpr std::size_t stride = Adjacent ? block_size : block_size + 1;
+
+    std::vector<std::thread> readers;
+    for (std::size_t t = 0; t < reader_count; ++t) {
+        readers.emplace_back([&, t]() {
+            std::deque<shared_lock> window;
+            std::size_t count = 0;
+            std::size_t b = t * stream_size;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                window.push_back(locker_.lock_shared(b, b + block_size));
+                if (window.size() > window_size)
+                    window.pop_front();
+                b += stride;
+                ++count;
+            }
+
+            reads += count;
+        });
+    }
+
+    std::thread writer([&]() {
+        std::size_t count = 0;
+        std::size_t b = reader_count * stream_size;
+
+        while (!stop.load(std::memory_order_relaxed)) {
+            // Rotating bounds, so no range gets a dedicated lock
+            auto lock = locker_.lock_exclusive(b, b + 1 + count % 1000);
+            ++count;
+        }
+
+        updates += count;
+    });
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+
+    writer.join();
+    for (auto &&th : readers)
+        th.join();
+
+    double seconds = std::chrono::duration<double>(duration).count();
+    return {reads / seconds, updates / seconds};
+}
+
+int main() {
+    std::printf("blocks read and records updated per second, windows of %zu blocks (%u hardware threads)\n", window_size, std::thread::hardware_concurrency());
+    std::printf("%8s %14s %14s %14s %14s\n", "readers", "gap reads", "gap updates", "adjacent reads", "adjacent upd.");
+
+    for (std::size_t reader_count : reader_counts) {
+        result a = run<false>(reader_count);
+        result b = run<true>(reader_count);
+        std::printf("%8zu %14.0f %14.0f %14.0f %14.0f\n", reader_count, a.reads, a.updates, b.reads, b.updates);
+    }
+}
@@ -0,0 +1,77 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "combining_locker.hpp"
+#include "locker.hpp"
+
+/*
+    Throughput of locker vs. combining_locker at 8, 32 and 128 threads.
+
+    All the threads lock short random intervals in one small region of the
+    key space, 1 in 10 locks is exclusive, so every lock/unlock contends for
+    the critical section and some of them conflict. The locker hands its
+    mutex over once per request, the combining locker once per batch.
+*/
+
+using namespace std::chrono_literals;
+
+constexpr std::size_t thread_counts[] = {8, 32, 128};
+constexpr std::size_t region = 100'000;
+constexpr std::size_t max_width = 100;
+constexpr auto duration = 500ms;
+
+template<class Locker>
+double run(std::size_t thread_count) {
+    Locker locker_;
+    locker_.reserve(thread_count);
+
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> operations{0};
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 gen(t);
+            std::uniform_int_distribution<std::size_t> offset(0, region - max_width);
+            std::uniform_int_distribution<std::size_t> width(1, max_width);
+            std::size_t count = 0;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                std::size_t b = offset(gen);
+                std::size_t e = b + width(gen);
+
+                if (count % 10 == 0) {
+                    auto lock = locker_.lock_exclusive(b, e);
+                } else {
+                    auto lock = locker_.lock_shared(b, e);
+                }
+                ++count;
+            }
+
+            operations += count;
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+
+    for (auto &&th : threads)
+        th.join();
+
+    return operations / std::chrono::duration<double>(duration).count();
+}
+
+int main() {
+    std::printf("lock/unlock pairs per second (%u hardware threads)\n", std::thread::hardware_concurrency());
+    std::printf("%8s %16s %18s\n", "threads", "locker", "combining_locker");
+
+    for (std::size_t thread_count : thread_counts) {
+        double a = run<locker>(thread_count);
+        double b = run<combining_locker>(thread_count);
+        std::printf("%8zu %16.0f %18.0f\n", thread_count, a, b);
+    }
+}
@@ -0,0 +1,89 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+
+/*
+    A thread locking many small ranges at once, while other threads lock
+    ranges elsewhere.
+
+    The bulk thread takes lock_count exclusive locks, then releases them,
+    over and over. With the ranges next to each other in one region they
+    are escalated every escalation_threshold locks, and the tree keeps a
+    covering lock in their place; with every range in a region of its own
+    they all stay in the tree. The other threads lock and unlock ranges far
+    from the bulk ones, searching that tree.
+*/
+
+using namespace std::chrono_literals;
+
+constexpr std::size_t other_counts[] = {0, 1, 4};
+constexpr std::size_t lock_count = 10000;
+constexpr auto duration = 500ms;
+
+struct result {
+    double passes;
+    double locks;
+};
+
+template<bool Nearby>
+result run(std::size_t other_count) {
+    locker locker_;
+
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> passes{0};
+    std::atomic<std::size_t> locks{0};
+
+    auto key = [](std::size_t i) -> std::size_t { return Nearby ? i : i << locker::escalation_region_shift; };
+
+    std::thread bulk([&]() {
+        std::vector<exclusive_lock> held;
+        held.reserve(lock_count);
+        while (!stop.load(std::memory_order_relaxed)) {
+            for (std::size_t i = 0; i < lock_count; ++i)
+                held.push_back(locker_.lock_exclusive(key(i), key(i) + 1));
+            held.clear();
+            ++passes;
+        }
+    });
+
+    std::vector<std::thread> others;
+    for (std::size_t t = 0; t < other_count; ++t) {
+        others.emplace_back([&, t]() {
+            std::size_t count = 0;
+            std::size_t b = (2 * lock_count + t) << locker::escalation_region_shift;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                // Rotating bounds, so no range gets a dedicated lock
+                auto lock = locker_.lock_exclusive(b, b + 1 + count % 1000);
+                ++count;
+            }
+
+            locks += count;
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+
+    bulk.join();
+    for (auto &&th : others)
+        th.join();
+
+    double seconds = std::chrono::duration<double>(duration).count();
+    return {passes / seconds, locks / seconds};
+}
+
+int main() {
+    std::printf("bulk passes of %zu locks and other locks per second (%u hardware threads)\n", lock_count, std::thread::hardware_concurrency());
+    std::printf("%8s %16s %16s %16s %16s\n", "others", "scattered bulk", "scattered other", "nearby bulk", "nearby other");
+
+    for (std::size_t other_count : other_counts) {
+        result a = run<false>(other_count);
+        result b = run<true>(other_count);
+        std::printf("%8zu %16.1f %16.0f %16.1f %16.0f\n", other_count, a.passes, a.locks, b.passes, b.locks);
+    }
+}
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+
+/*
+    Wait times per fairness policy.
+
+    Reader threads keep taking overlapping shared locks on a hot range,
+    writer threads periodically ask for exclusive locks on the same range.
+    With `reader_preferring` the readers can starve the writers, the other
+    policies bound the writers' tail latency (at the readers' expense).
+*/
+
+using clock_type = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+constexpr std::size_t reader_count = 8;
+constexpr std::size_t writer_count = 2;
+constexpr std::size_t hot_range = 1000;
+constexpr std::size_t max_width = 200;
+constexpr auto reader_hold = 50us;
+constexpr auto writer_hold = 20us;
+constexpr auto writer_pause = 1ms;
+constexpr auto duration = 2s;
+
+struct percentiles {
+    double p50, p99, max;
+    std::size_t samples;
+};
+
+static percentiles summarize(std::vector<double> &samples) {
+    if (samples.empty())
+        return {0, 0, 0, 0};
+
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) { return samples[std::min(samples.size() - 1, std::size_t(q * samples.size()))]; };
+
+    return {at(0.5), at(0.99), samples.back(), samples.size()};
+}
+
+template<class Policy>
+void run(const char *name) {
+    basic_locker<Policy> locker_;
+    std::atomic<bool> stop{false};
+    std::mutex samples_mutex;
+    std::vector<double> reader_waits, writer_waits;
+
+    auto worker = [&](std::size_t seed, bool writer) {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<std::size_t> width(1, max_width);
+        std::vector<double> waits;
+
+        while (!stop.load(std::memory_order_relaxed)) {
+            std::size_t w = width(gen);
+            std::size_t b = std::uniform_int_distribution<std::size_t>(0, hot_range - w)(gen);
+
+            auto start = clock_type::now();
+
+            if (writer) {
+                auto lock = locker_.lock_exclusive(b, b + w);
+                waits.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - start).count());
+                std::this_thread::sleep_for(writer_hold);
+                lock.unlock();
+                std::this_thread::sleep_for(writer_pause);
+            } else {
+                auto lock = locker_.lock_shared(b, b + w);
+                waits.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - start).count());
+                std::this_thread::sleep_for(reader_hold);
+            }
+        }
+
+        std::lock_guard guard(samples_mutex);
+        auto &all = writer ? writer_waits : reader_waits;
+        all.insert(all.end(), waits.begin(), waits.end());
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < reader_count; ++i)
+        threads.emplace_back(worker, i, false);
+    for (std::size_t i = 0; i < writer_count; ++i)
+        threads.emplace_back(worker, reader_count + i, true);
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+
+    for (auto &&th : threads)
+        th.join();
+
+    auto readers = summarize(reader_waits);
+    auto writers = summarize(writer_waits);
+
+    std::printf("%-18s | writers %8zu p50 %10.1f p99 %10.1f max %10.1f | readers %8zu p50 %8.1f p99 %10.1f max %10.1f\n",
+        name, writers.samples, writers.p50, writers.p99, writers.max,
+        readers.samples, readers.p50, readers.p99, readers.max);
+}
+
+int main() {
+    std::printf("lock wait times in microseconds\n");
+    run<reader_preferring>("reader_preferring");
+    run<writer_preferring>("writer_preferring");
+    run<fifo_per_overlap>("fifo_per_overlap");
+}
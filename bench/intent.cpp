@@ -0,0 +1,107 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+
+/*
+    A file scanned over and over while writers update its records.
+
+    The file has 1000 pages of 64 records. Without intent locks the scanner
+    holds a shared lock over the whole file for a whole pass, and every
+    writer waits for the pass to end. With intent locks the scanner holds IS
+    over the file and a shared lock on the page it reads, the writers take
+    IX over the file and an exclusive lock on their record, so a writer only
+    waits while the scanner reads its page.
+*/
+
+using namespace std::chrono_literals;
+
+constexpr std::size_t writer_counts[] = {1, 4, 16};
+constexpr std::size_t page_count = 1000;
+constexpr std::size_t page_size = 64;
+constexpr std::size_t file_size = page_count * page_size;
+constexpr auto duration = 500ms;
+
+struct result {
+    double passes;
+    double updates;
+};
+
+template<bool Intent>
+result run(std::size_t writer_count) {
+    locker locker_;
+
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> passes{0};
+    std::atomic<std::size_t> updates{0};
+    std::vector<std::atomic<std::size_t>> records(file_size);
+
+    // Keeps the reads from being optimized away
+    std::atomic<std::size_t> checksum{0};
+
+    std::thread scanner([&]() {
+        std::size_t sum = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if constexpr (Intent) {
+                auto file = locker_.lock_intent(0, file_size, lock_mode::intent_shared);
+                for (std::size_t page = 0; page < page_count; ++page) {
+                    auto lock = locker_.lock_shared(page * page_size, (page + 1) * page_size);
+                    for (std::size_t i = page * page_size; i < (page + 1) * page_size; ++i)
+                        sum += records[i].load(std::memory_order_relaxed);
+                }
+            } else {
+                auto file = locker_.lock_shared(0, file_size);
+                for (std::size_t i = 0; i < file_size; ++i)
+                    sum += records[i].load(std::memory_order_relaxed);
+            }
+            ++passes;
+        }
+        checksum += sum;
+    });
+
+    std::vector<std::thread> writers;
+    for (std::size_t t = 0; t < writer_count; ++t) {
+        writers.emplace_back([&, t]() {
+            std::size_t count = 0;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                std::size_t record = (t * 7919 + count * 104729) % file_size;
+                if constexpr (Intent) {
+                    auto file = locker_.lock_intent(0, file_size, lock_mode::intent_exclusive);
+                    auto lock = locker_.lock_exclusive(record, record + 1);
+                    records[record].fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    auto lock = locker_.lock_exclusive(record, record + 1);
+                    records[record].fetch_add(1, std::memory_order_relaxed);
+                }
+                ++count;
+            }
+
+            updates += count;
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+
+    scanner.join();
+    for (auto &&th : writers)
+        th.join();
+
+    double seconds = std::chrono::duration<double>(duration).count();
+    return {passes / seconds, updates / seconds};
+}
+
+int main() {
+    std::printf("scan passes and record updates per second (%u hardware threads)\n", std::thread::hardware_concurrency());
+    std::printf("%8s %14s %14s %14s %14s\n", "writers", "S passes", "S updates", "IS passes", "IS updates");
+
+    for (std::size_t writer_count : writer_counts) {
+        result a = run<false>(writer_count);
+        result b = run<true>(writer_count);
+        std::printf("%8zu %14.0f %14.0f %14.0f %14.0f\n", writer_count, a.passes, a.updates, b.passes, b.updates);
+    }
+}
@@ -0,0 +1,49 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "locker.hpp"
+
+/*
+    The critical section of lock_exclusive/unlock with many held intervals.
+
+    The main thread holds `held` disjoint exclusive locks, one per region
+    of keys (so they are never escalated), then locks and unlocks random
+    ranges in the gaps between them. Every pair inserts a node into and
+    erases it from a tree of `held` nodes, so the time per pair follows
+    the cost of those two updates.
+*/
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t held_counts[] = {1'000, 100'000, 1'000'000};
+constexpr std::size_t pairs = 1'000'000;
+constexpr std::size_t stride = std::size_t{1} << 33;
+
+double run(std::size_t held) {
+    locker locker_;
+
+    std::vector<exclusive_lock> locks;
+    locks.reserve(held);
+    for (std::size_t i = 0; i < held; ++i)
+        locks.push_back(locker_.lock_exclusive(i * stride, i * stride + 10));
+
+    std::mt19937_64 random(42);
+    auto start = clock_type::now();
+
+    for (std::size_t i = 0; i < pairs; ++i) {
+        std::size_t b = random() % held * stride + 20 + i % 1000;
+        auto lock = locker_.lock_exclusive(b, b + 10);
+    }
+
+    return std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / pairs;
+}
+
+int main() {
+    std::printf("ns per lock_exclusive/unlock pair with the intervals held\n");
+    std::printf("%10s %10s\n", "held", "ns");
+
+    for (std::size_t held : held_counts)
+        std::printf("%10zu %10.1f\n", held, run(held));
+}
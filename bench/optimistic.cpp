@@ -0,0 +1,94 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+
+/*
+    Reads of a small metadata range: lock_shared vs. read_version/validate.
+
+    `thread_count` readers read two words of one range, a writer updates
+    them under an exclusive lock every 100 us. A shared lock takes the mutex
+    and inserts into the tree twice per read, an optimistic read only loads
+    the version stripes of the range (and retries when a write got in).
+*/
+
+using namespace std::chrono_literals;
+
+constexpr std::size_t thread_counts[] = {1, 4, 16};
+constexpr auto duration = 500ms;
+
+template<bool Optimistic>
+double run(std::size_t thread_count) {
+    locker locker_;
+
+    std::atomic<std::size_t> first{0};
+    std::atomic<std::size_t> second{0};
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> reads{0};
+
+    // Keeps the reads from being optimized away
+    std::atomic<std::size_t> checksum{0};
+
+    std::thread writer([&]() {
+        for (std::size_t i = 1; !stop.load(std::memory_order_relaxed); ++i) {
+            {
+                auto lock = locker_.lock_exclusive(0, 16);
+                first.store(i, std::memory_order_relaxed);
+                second.store(i, std::memory_order_relaxed);
+            }
+            std::this_thread::sleep_for(100us);
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&]() {
+            std::size_t count = 0;
+            std::size_t sum = 0;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                if constexpr (Optimistic) {
+                    while (true) {
+                        auto token = locker_.read_version(0, 16);
+                        std::size_t a = first.load(std::memory_order_relaxed);
+                        std::size_t b = second.load(std::memory_order_relaxed);
+                        if (locker_.validate(token)) {
+                            sum += a + b;
+                            break;
+                        }
+                    }
+                } else {
+                    auto lock = locker_.lock_shared(0, 16);
+                    sum += first.load(std::memory_order_relaxed) + second.load(std::memory_order_relaxed);
+                }
+                ++count;
+            }
+
+            reads += count;
+            checksum += sum;
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+
+    for (auto &&th : threads)
+        th.join();
+    writer.join();
+
+    return reads / std::chrono::duration<double>(duration).count();
+}
+
+int main() {
+    std::printf("reads per second (%u hardware threads)\n", std::thread::hardware_concurrency());
+    std::printf("%8s %14s %14s\n", "threads", "lock_shared", "optimistic");
+
+    for (std::size_t thread_count : thread_counts) {
+        double a = run<false>(thread_count);
+        double b = run<true>(thread_count);
+        std::printf("%8zu %14.0f %14.0f\n", thread_count, a, b);
+    }
+}
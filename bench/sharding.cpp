@@ -0,0 +1,94 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "sharded_locker.hpp"
+
+/*
+    Throughput of locker vs. sharded_locker from 1 to 64 threads.
+
+    Every thread locks short random intervals in its own region of the key
+    space (the threads never conflict), 1 in 10 locks is exclusive. With a
+    single locker all of them serialize on one mutex, the sharded locker
+    gives every region its own partition.
+
+    The second table squeezes all the regions into the first partition of
+    the key space, where the fixed partitions degenerate into one locker
+    and the adaptive ones spread out over the hot regions.
+*/
+
+using clock_type = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+constexpr std::size_t max_threads = 64;
+constexpr std::size_t region = 1'000'000;
+constexpr std::size_t max_width = 100;
+constexpr auto duration = 500ms;
+
+template<class Locker>
+double run(Locker &locker_, std::size_t thread_count, std::size_t region_size = region) {
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> operations{0};
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 gen(t);
+            std::uniform_int_distribution<std::size_t> offset(0, region_size - max_width);
+            std::uniform_int_distribution<std::size_t> width(1, max_width);
+            std::size_t count = 0;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                std::size_t b = t * region_size + offset(gen);
+                std::size_t e = b + width(gen);
+
+                if (count % 10 == 0) {
+                    auto lock = locker_.lock_exclusive(b, e);
+                } else {
+                    auto lock = locker_.lock_shared(b, e);
+                }
+                ++count;
+            }
+
+            operations += count;
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+
+    for (auto &&th : threads)
+        th.join();
+
+    return operations / std::chrono::duration<double>(duration).count();
+}
+
+int main() {
+    std::printf("lock/unlock pairs per second (%u hardware threads)\n", std::thread::hardware_concurrency());
+    std::printf("%8s %16s %16s\n", "threads", "locker", "sharded_locker");
+
+    for (std::size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        locker single;
+        sharded_locker sharded(max_threads, max_threads * region);
+
+        double a = run(single, thread_count);
+        double b = run(sharded, thread_count);
+        std::printf("%8zu %16.0f %16.0f\n", thread_count, a, b);
+    }
+
+    std::printf("\nskewed, all the threads in the first partition\n");
+    std::printf("%8s %16s %16s\n", "threads", "fixed", "adaptive");
+
+    for (std::size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        sharded_locker fixed(max_threads, max_threads * region);
+        sharded_locker adaptive(max_threads, max_threads * region, sharding::adaptive);
+
+        double a = run(fixed, thread_count, region / max_threads);
+        double b = run(adaptive, thread_count, region / max_threads);
+        std::printf("%8zu %16.0f %16.0f\n", thread_count, a, b);
+    }
+}
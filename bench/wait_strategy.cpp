@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+
+/*
+    Acquisition latency with wait_strategy::park vs. spin_then_park vs.
+    handoff.
+
+    `thread_count` threads take turns on one exclusive range and hold it for
+    a few microseconds (busy), the latency of every lock_exclusive call is
+    recorded. Parking costs two context switches per contended acquisition,
+    spinning does not, as long as the holder runs on another CPU (on a
+    single CPU nobody spins). With handoff the releasing thread cannot take
+    the range again ahead of the waiters it woke up.
+*/
+
+using clock_type = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+constexpr std::size_t thread_count = 4;
+constexpr std::size_t iterations = 20'000;
+constexpr auto hold = 2us;
+
+void run(const char *name, wait_strategy strategy) {
+    locker locker_(strategy);
+    std::vector<std::vector<double>> latencies(thread_count);
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            latencies[t].reserve(iterations);
+
+            for (std::size_t i = 0; i < iterations; ++i) {
+                auto start = clock_type::now();
+                auto lock = locker_.lock_exclusive(0, 10);
+                auto acquired = clock_type::now();
+                latencies[t].push_back(std::chrono::duration<double, std::micro>(acquired - start).count());
+
+                while (clock_type::now() - acquired < hold) {
+                }
+            }
+        });
+    }
+
+    for (auto &&th : threads)
+        th.join();
+
+    std::vector<double> all;
+    for (auto &l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+
+    std::printf("%-16s %10.2f %10.2f %10.2f\n", name, all[all.size() / 2], all[all.size() * 99 / 100], all.back());
+}
+
+int main() {
+    std::printf("lock_exclusive latency in microseconds, %zu threads, holds of %lld us (%u hardware threads)\n",
+                thread_count, static_cast<long long>(hold.count()), std::thread::hardware_concurrency());
+    std::printf("%-16s %10s %10s %10s\n", "strategy", "median", "p99", "max");
+
+    run("park", wait_strategy::park);
+    run("spin_then_park", wait_strategy::spin_then_park);
+    run("handoff", wait_strategy::handoff);
+}
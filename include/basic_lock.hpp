@@ -0,0 +1,548 @@
+#ifndef INTERVAL_LOCK_BASIC_LOCK_HPP
+#define INTERVAL_LOCK_BASIC_LOCK_HPP
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+// The lock handles are shared by all the locker engines. `Locker` is the engine that issued the lock,
+// `Handle` refers to the engine's record of the lock (engines keep these addresses stable), so releasing
+// a lock never has to search for it. An engine provides:
+//
+//   void unlock_shared(Handle);
+//   void unlock_exclusive(Handle);
+//   basic_exclusive_lock<Locker, Handle> actual_upgrade(Handle);
+//   basic_shared_lock<Locker, Handle> actual_downgrade(Handle);
+//
+// and optionally (for the timed and the stoppable upgrade)
+//
+//   basic_exclusive_lock<Locker, Handle> actual_try_upgrade_until(Handle, time_point); // an empty lock on timeout
+//   basic_exclusive_lock<Locker, Handle> actual_upgrade(Handle, std::stop_token);       // an empty lock once stopped
+//
+// and (for basic_lock_set)
+//
+//   void unlock_many(std::span<const Handle>); // release all of them at once
+//
+// An engine with intent modes hands out basic_intent_lock<Locker, IntentHandle> as well, it provides:
+//
+//   void unlock_intent(IntentHandle, lock_mode);
+//   Locker::exclusive_lock actual_upgrade(IntentHandle); // of an update lock
+
+// The modes of multi-granularity locking. A range is locked in an intent mode before ranges inside it are locked in
+// the corresponding real modes (shared/exclusive), so a coarse lock and the fine locks under it do not block each other.
+enum class lock_mode{
+    intent_shared,              // IS: shared locks will be taken inside the range
+    intent_exclusive,           // IX: shared or exclusive locks will be taken inside the range
+    shared,                     // S
+    shared_intent_exclusive,    // SIX: S over the range plus IX (a scan updating some of what it reads)
+    update,                     // U: S which may be upgraded to X, one at a time, so two upgrades cannot deadlock
+    exclusive                   // X
+};
+
+// Whether locks in modes `a` and `b` can be held over overlapping ranges at the same time.
+constexpr bool lock_modes_compatible(lock_mode a, lock_mode b) noexcept {
+    constexpr bool matrix[6][6] = {
+        //            IS     IX     S      SIX    U      X
+        /* IS  */   {true,  true,  true,  true,  true,  false},
+        /* IX  */   {true,  true,  false, false, false, false},
+        /* S   */   {true,  false, true,  false, true,  false},
+        /* SIX */   {true,  false, false, false, false, false},
+        /* U   */   {true,  false, true,  false, false, false},
+        /* X   */   {false, false, false, false, false, false},
+    };
+    return matrix[static_cast<int>(a)][static_cast<int>(b)];
+}
+
+template<class Locker, class Handle>
+class basic_exclusive_lock;
+
+template<class Locker, class Handle>
+class basic_lock_set;
+
+template<class Locker, class Handle>
+class basic_shared_lock {
+
+public:
+
+    using interval = std::pair<std::size_t , std::size_t>;
+    using node_handle = Handle;
+    using exclusive_lock = basic_exclusive_lock<Locker, Handle>;
+
+    basic_shared_lock() noexcept {
+        p_MainLocker = nullptr;
+        node_ = Handle{};
+    }
+
+    explicit basic_shared_lock(Locker* ptr_main_locker, node_handle node) {
+        p_MainLocker = ptr_main_locker;
+        node_ = node;
+    }
+
+    basic_shared_lock(const basic_shared_lock&) = delete; // no support for copy
+    basic_shared_lock& operator=(const basic_shared_lock&) = delete; // no support for copy
+
+    basic_shared_lock(basic_shared_lock&&) noexcept; // move, invalidate source object
+    basic_shared_lock& operator=(basic_shared_lock&&) noexcept; // unlock `*this` (if not invalid), move, invalidate source object
+
+    ~basic_shared_lock(); // unlock (if not invalid), noexcept by default
+
+    void unlock() noexcept;  // unlock (if not invalid), invalidate
+    node_handle release() noexcept; // invalidate without unlocking, return the handle (Handle{} if invalid)
+    exclusive_lock upgrade();   // BLOCKING, upgrade to exclusive_lock, invalidate `*this`
+
+    // like upgrade(), but gives up at the deadline and returns an empty lock, `*this` stays locked then
+    template<class Rep, class Period>
+    exclusive_lock try_upgrade_for(const std::chrono::duration<Rep, Period>& timeout);
+    template<class Clock, class Duration>
+    exclusive_lock try_upgrade_until(const std::chrono::time_point<Clock, Duration>& deadline);
+
+    // like upgrade(), but gives up once a stop is requested on `token` and returns an empty lock, `*this` stays locked then
+    exclusive_lock upgrade(std::stop_token token);
+
+    bool owns_lock() const noexcept { return p_MainLocker != nullptr; }
+    explicit operator bool() const noexcept { return owns_lock(); }
+
+private:
+    friend basic_lock_set<Locker, Handle>;
+
+    Locker* p_MainLocker;
+    node_handle node_;
+
+};
+
+template<class Locker, class Handle>
+class basic_exclusive_lock {
+public:
+
+    using interval = std::pair<std::size_t , std::size_t>;
+    using node_handle = Handle;
+    using shared_lock = basic_shared_lock<Locker, Handle>;
+
+
+    basic_exclusive_lock() noexcept {
+        p_MainLocker = nullptr;
+        node_ = Handle{};
+    }
+
+    explicit basic_exclusive_lock(Locker* ptr_main_locker, node_handle node){
+        p_MainLocker = ptr_main_locker;
+        node_ = node;
+    }
+
+    basic_exclusive_lock(const basic_exclusive_lock&) = delete; // no support for copy
+    basic_exclusive_lock& operator=(const basic_exclusive_lock&) = delete; // no support for copy
+
+    basic_exclusive_lock(basic_exclusive_lock&&) noexcept; // move, invalidate source object
+    basic_exclusive_lock& operator=(basic_exclusive_lock&&) noexcept; // unlock `*this` (if not invalid), move, invalidate source object
+
+    ~basic_exclusive_lock(); // unlock (if not invalid), noexcept by default
+    void unlock() noexcept;
+    node_handle release() noexcept; // invalidate without unlocking, return the handle (Handle{} if invalid)
+
+    bool owns_lock() const noexcept { return p_MainLocker != nullptr; }
+    explicit operator bool() const noexcept { return owns_lock(); }
+
+    shared_lock downgrade() noexcept;   // downgrade to shared_lock, invalidate `*this`
+
+private:
+    friend basic_lock_set<Locker, Handle>;
+
+    Locker* p_MainLocker;
+    node_handle node_;
+
+};
+
+// A set of locks (shared or exclusive) of one engine, released together in one critical section.
+// Filled either by the engine (lock_many) or by taking over individual locks.
+template<class Locker, class Handle>
+class basic_lock_set {
+public:
+
+    using node_handle = Handle;
+    using shared_lock = basic_shared_lock<Locker, Handle>;
+    using exclusive_lock = basic_exclusive_lock<Locker, Handle>;
+
+    basic_lock_set() noexcept {
+        p_MainLocker = nullptr;
+    }
+
+    explicit basic_lock_set(Locker* ptr_main_locker, std::vector<node_handle> nodes) {
+        p_MainLocker = ptr_main_locker;
+        nodes_ = std::move(nodes);
+    }
+
+    basic_lock_set(const basic_lock_set&) = delete; // no support for copy
+    basic_lock_set& operator=(const basic_lock_set&) = delete; // no support for copy
+
+    basic_lock_set(basic_lock_set&&) noexcept; // move, invalidate source object
+    basic_lock_set& operator=(basic_lock_set&&) noexcept; // unlock `*this` (if not invalid), move, invalidate source object
+
+    ~basic_lock_set(); // unlock (if not invalid)
+
+    void insert(shared_lock&& lock); // take over `lock` (of the same engine), invalidate `lock`
+    void insert(exclusive_lock&& lock); // take over `lock` (of the same engine), invalidate `lock`
+
+    void unlock_all() noexcept; // unlock all the locks (if not invalid), invalidate
+
+    std::size_t size() const noexcept { return nodes_.size(); }
+
+    bool owns_lock() const noexcept { return p_MainLocker != nullptr; }
+    explicit operator bool() const noexcept { return owns_lock(); }
+
+private:
+    Locker* p_MainLocker;
+    std::vector<node_handle> nodes_;
+
+};
+
+// A lock in one of the intent modes or in update mode.
+template<class Locker, class Handle>
+class basic_intent_lock {
+public:
+
+    using interval = std::pair<std::size_t , std::size_t>;
+    using node_handle = Handle;
+
+    basic_intent_lock() noexcept {
+        p_MainLocker = nullptr;
+        node_ = Handle{};
+        mode_ = lock_mode::intent_shared;
+    }
+
+    explicit basic_intent_lock(Locker* ptr_main_locker, node_handle node, lock_mode mode) {
+        p_MainLocker = ptr_main_locker;
+        node_ = node;
+        mode_ = mode;
+    }
+
+    basic_intent_lock(const basic_intent_lock&) = delete; // no support for copy
+    basic_intent_lock& operator=(const basic_intent_lock&) = delete; // no support for copy
+
+    basic_intent_lock(basic_intent_lock&&) noexcept; // move, invalidate source object
+    basic_intent_lock& operator=(basic_intent_lock&&) noexcept; // unlock `*this` (if not invalid), move, invalidate source object
+
+    ~basic_intent_lock(); // unlock (if not invalid), noexcept by default
+
+    void unlock() noexcept;  // unlock (if not invalid), invalidate
+
+    // BLOCKING, update locks only: upgrade to an exclusive lock, invalidate `*this`
+    auto upgrade();
+
+    lock_mode mode() const noexcept { return mode_; }
+
+    bool owns_lock() const noexcept { return p_MainLocker != nullptr; }
+    explicit operator bool() const noexcept { return owns_lock(); }
+
+private:
+    Locker* p_MainLocker;
+    node_handle node_;
+    lock_mode mode_;
+
+};
+
+//// --------
+// EXCLUSIVE LOCK METHODS
+
+//exclusive_lock(exclusive_lock&&) noexcept; // move, invalidate source object
+//exclusive_lock& operator=(exclusive_lock&&) noexcept; // unlock `*this` (if not invalid), move, invalidate source object
+//
+//~exclusive_lock(); // unlock (if not invalid), noexcept by default
+//void unlock() noexcept;
+//
+//shared_lock downgrade() noexcept;   // downgrade to shared_lock, invalidate `*this`
+
+template<class Locker, class Handle>
+basic_exclusive_lock<Locker, Handle>::basic_exclusive_lock(basic_exclusive_lock &&other) noexcept {
+    p_MainLocker = other.p_MainLocker;
+    node_ = other.node_;
+    other.p_MainLocker = nullptr;
+    other.node_ = Handle{};
+}
+
+template<class Locker, class Handle>
+basic_exclusive_lock<Locker, Handle> &basic_exclusive_lock<Locker, Handle>::operator=(basic_exclusive_lock &&other) noexcept {
+    if (this != &other) {
+        if (p_MainLocker) {
+            p_MainLocker->unlock_exclusive(node_);
+        }
+
+        p_MainLocker = other.p_MainLocker;
+        node_ = other.node_;
+        other.p_MainLocker = nullptr;
+        other.node_ = Handle{};
+    }
+    return *this;
+}
+
+template<class Locker, class Handle>
+basic_exclusive_lock<Locker, Handle>::~basic_exclusive_lock() {
+
+    if (p_MainLocker != nullptr) {
+        p_MainLocker->unlock_exclusive(node_);
+    }
+}
+
+template<class Locker, class Handle>
+void basic_exclusive_lock<Locker, Handle>::unlock() noexcept {
+    if (p_MainLocker != nullptr) {
+        p_MainLocker->unlock_exclusive(node_);
+        p_MainLocker = nullptr;
+    }
+}
+
+template<class Locker, class Handle>
+Handle basic_exclusive_lock<Locker, Handle>::release() noexcept {
+    if (p_MainLocker == nullptr) {
+        return Handle{};
+    }
+
+    p_MainLocker = nullptr;
+    return std::exchange(node_, Handle{});
+}
+
+template<class Locker, class Handle>
+basic_shared_lock<Locker, Handle> basic_exclusive_lock<Locker, Handle>::downgrade() noexcept {
+
+    shared_lock result;
+    if (p_MainLocker != nullptr){
+        result = p_MainLocker->actual_downgrade(node_);
+    }
+
+    p_MainLocker = nullptr;
+
+    return result;
+}
+
+//// --------
+// SHARED LOCK METHODS
+
+//shared_lock(shared_lock&&) noexcept; // move, invalidate source object
+//shared_lock& operator=(shared_lock&&) noexcept; // unlock `*this` (if not invalid), move, invalidate source object
+//
+//~shared_lock(); // unlock (if not invalid), noexcept by default
+//
+//void unlock() noexcept;  // unlock (if not invalid), invalidate
+//exclusive_lock upgrade();   // BLOCKING, upgrade to exclusive_lock, invalidate `*this`
+
+template<class Locker, class Handle>
+basic_shared_lock<Locker, Handle>::basic_shared_lock(basic_shared_lock &&other ) noexcept {
+    p_MainLocker = other.p_MainLocker;
+    node_ = other.node_;
+    other.p_MainLocker = nullptr;
+    other.node_ = Handle{};
+}
+
+template<class Locker, class Handle>
+basic_shared_lock<Locker, Handle> &basic_shared_lock<Locker, Handle>::operator=(basic_shared_lock &&other) noexcept {
+    if (this != &other) {
+        if (p_MainLocker) {
+            p_MainLocker->unlock_shared(node_);
+        }
+
+        p_MainLocker = other.p_MainLocker;
+        node_ = other.node_;
+        other.p_MainLocker = nullptr;
+        other.node_ = Handle{};
+    }
+    return *this;
+}
+
+template<class Locker, class Handle>
+basic_shared_lock<Locker, Handle>::~basic_shared_lock() {
+    if (p_MainLocker != nullptr) {
+        p_MainLocker->unlock_shared(node_);
+    }
+}
+
+template<class Locker, class Handle>
+void basic_shared_lock<Locker, Handle>::unlock() noexcept {
+
+    if (p_MainLocker != nullptr) {
+        p_MainLocker->unlock_shared(node_);
+        p_MainLocker = nullptr;
+    }
+}
+
+template<class Locker, class Handle>
+Handle basic_shared_lock<Locker, Handle>::release() noexcept {
+    if (p_MainLocker == nullptr) {
+        return Handle{};
+    }
+
+    p_MainLocker = nullptr;
+    return std::exchange(node_, Handle{});
+}
+
+template<class Locker, class Handle>
+basic_exclusive_lock<Locker, Handle> basic_shared_lock<Locker, Handle>::upgrade() {
+
+    exclusive_lock result;
+    if (p_MainLocker != nullptr){
+        result = p_MainLocker->actual_upgrade(node_);
+        p_MainLocker = nullptr;
+    }
+
+    return result;
+}
+
+template<class Locker, class Handle>
+template<class Rep, class Period>
+basic_exclusive_lock<Locker, Handle> basic_shared_lock<Locker, Handle>::try_upgrade_for(const std::chrono::duration<Rep, Period>& timeout) {
+    return try_upgrade_until(std::chrono::steady_clock::now() + timeout);
+}
+
+template<class Locker, class Handle>
+template<class Clock, class Duration>
+basic_exclusive_lock<Locker, Handle> basic_shared_lock<Locker, Handle>::try_upgrade_until(const std::chrono::time_point<Clock, Duration>& deadline) {
+
+    exclusive_lock result;
+    if (p_MainLocker != nullptr){
+        result = p_MainLocker->actual_try_upgrade_until(node_, deadline);
+
+        if (result){
+            p_MainLocker = nullptr;
+        }
+    }
+
+    return result;
+}
+
+template<class Locker, class Handle>
+basic_exclusive_lock<Locker, Handle> basic_shared_lock<Locker, Handle>::upgrade(std::stop_token token) {
+
+    exclusive_lock result;
+    if (p_MainLocker != nullptr){
+        result = p_MainLocker->actual_upgrade(node_, std::move(token));
+
+        if (result){
+            p_MainLocker = nullptr;
+        }
+    }
+
+    return result;
+}
+
+//// --------
+// INTENT LOCK METHODS
+
+template<class Locker, class Handle>
+basic_intent_lock<Locker, Handle>::basic_intent_lock(basic_intent_lock &&other) noexcept {
+    p_MainLocker = other.p_MainLocker;
+    node_ = other.node_;
+    mode_ = other.mode_;
+    other.p_MainLocker = nullptr;
+    other.node_ = Handle{};
+}
+
+template<class Locker, class Handle>
+basic_intent_lock<Locker, Handle> &basic_intent_lock<Locker, Handle>::operator=(basic_intent_lock &&other) noexcept {
+    if (this != &other) {
+        if (p_MainLocker) {
+            p_MainLocker->unlock_intent(node_, mode_);
+        }
+
+        p_MainLocker = other.p_MainLocker;
+        node_ = other.node_;
+        mode_ = other.mode_;
+        other.p_MainLocker = nullptr;
+        other.node_ = Handle{};
+    }
+    return *this;
+}
+
+template<class Locker, class Handle>
+basic_intent_lock<Locker, Handle>::~basic_intent_lock() {
+    if (p_MainLocker != nullptr) {
+        p_MainLocker->unlock_intent(node_, mode_);
+    }
+}
+
+template<class Locker, class Handle>
+void basic_intent_lock<Locker, Handle>::unlock() noexcept {
+
+    if (p_MainLocker != nullptr) {
+        p_MainLocker->unlock_intent(node_, mode_);
+        p_MainLocker = nullptr;
+    }
+}
+
+template<class Locker, class Handle>
+auto basic_intent_lock<Locker, Handle>::upgrade() {
+
+    typename Locker::exclusive_lock result;
+    if (p_MainLocker != nullptr){
+        assert(mode_ == lock_mode::update);
+        result = p_MainLocker->actual_upgrade(node_);
+        p_MainLocker = nullptr;
+    }
+
+    return result;
+}
+
+//// --------
+// LOCK SET METHODS
+
+template<class Locker, class Handle>
+basic_lock_set<Locker, Handle>::basic_lock_set(basic_lock_set &&other) noexcept {
+    p_MainLocker = other.p_MainLocker;
+    nodes_ = std::move(other.nodes_);
+    other.p_MainLocker = nullptr;
+    other.nodes_.clear();
+}
+
+template<class Locker, class Handle>
+basic_lock_set<Locker, Handle> &basic_lock_set<Locker, Handle>::operator=(basic_lock_set &&other) noexcept {
+    if (this != &other) {
+        unlock_all();
+
+        p_MainLocker = other.p_MainLocker;
+        nodes_ = std::move(other.nodes_);
+        other.p_MainLocker = nullptr;
+        other.nodes_.clear();
+    }
+    return *this;
+}
+
+template<class Locker, class Handle>
+basic_lock_set<Locker, Handle>::~basic_lock_set() {
+    unlock_all();
+}
+
+template<class Locker, class Handle>
+void basic_lock_set<Locker, Handle>::insert(shared_lock&& lock) {
+    if (lock.p_MainLocker != nullptr) {
+        assert(p_MainLocker == nullptr || p_MainLocker == lock.p_MainLocker);
+
+        nodes_.push_back(lock.node_);
+        p_MainLocker = lock.p_MainLocker;
+        lock.p_MainLocker = nullptr;
+        lock.node_ = Handle{};
+    }
+}
+
+template<class Locker, class Handle>
+void basic_lock_set<Locker, Handle>::insert(exclusive_lock&& lock) {
+    if (lock.p_MainLocker != nullptr) {
+        assert(p_MainLocker == nullptr || p_MainLocker == lock.p_MainLocker);
+
+        nodes_.push_back(lock.node_);
+        p_MainLocker = lock.p_MainLocker;
+        lock.p_MainLocker = nullptr;
+        lock.node_ = Handle{};
+    }
+}
+
+template<class Locker, class Handle>
+void basic_lock_set<Locker, Handle>::unlock_all() noexcept {
+    if (p_MainLocker != nullptr) {
+        p_MainLocker->unlock_many(std::span<const node_handle>(nodes_));
+        p_MainLocker = nullptr;
+        nodes_.clear();
+    }
+}
+
+#endif //INTERVAL_LOCK_BASIC_LOCK_HPP
@@ -0,0 +1,436 @@
+#ifndef INTERVAL_LOCK_COMBINING_LOCKER_HPP
+#define INTERVAL_LOCK_COMBINING_LOCKER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "basic_lock.hpp"
+#include "locker.hpp"
+
+// Locker engine with a flat-combining critical section.
+//
+// A request (lock, unlock, upgrade, downgrade) that finds the mutex taken is published in a slot instead of waiting
+// for the mutex. Whoever holds the mutex is the combiner: it collects the published requests and applies them in one
+// pass over the tree (the releases first, each group in key order), and hands every thread its result. The other
+// threads only watch their own slot, so under contention the mutex changes hands once per batch rather than once
+// per request, and the tree stays in the combiner's cache. A request finding the mutex free is applied right away
+// (and the combiner takes the published ones along).
+//
+// A request that can not be granted stays in its slot (parked), its thread sleeps on the slot until a later pass
+// that released an overlapping interval grants it. Waiting requests are granted like `locker` does with reader_preferring,
+// a request waits only for the conflicting locks that are held.
+//
+// When all the slots are taken, a release is applied directly under the mutex (so the parked requests can not
+// keep the releases out), the other requests wait for a free slot.
+
+class combining_locker;
+
+using combining_shared_lock = basic_shared_lock<combining_locker, lock_tree::node*>;
+using combining_exclusive_lock = basic_exclusive_lock<combining_locker, lock_tree::node*>;
+
+class combining_locker {
+public:
+
+    using shared_lock = combining_shared_lock;
+    using exclusive_lock = combining_exclusive_lock;
+
+    friend shared_lock;
+    friend exclusive_lock;
+
+    using size_type = std::size_t;
+    using node_handle = lock_tree::node*;
+
+    static constexpr size_type default_slot_count = 128;
+
+    explicit combining_locker(size_type slot_count = default_slot_count)
+        : slot_count_(slot_count),
+          slots_(std::make_unique<Slot[]>(slot_count)),
+          published_(std::make_unique<std::atomic<std::uint64_t>[]>((slot_count + 63) / 64)){
+        assert(slot_count > 0);
+        batch_.reserve(slot_count);
+        parked_.reserve(slot_count);
+    }
+
+    combining_locker(const combining_locker&) = delete;
+    combining_locker(combining_locker&&) = delete;
+    combining_locker& operator=(const combining_locker&) = delete;
+    combining_locker& operator=(combining_locker&&) = delete;
+
+    ~combining_locker(){
+
+        // Wait until the tree is empty.
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return inter_tree.empty(); });
+    }
+
+    shared_lock lock_shared(size_type b, size_type e){
+        return shared_lock(this, execute(operation::lock_shared, {b, e}));
+    }
+
+    exclusive_lock lock_exclusive(size_type b, size_type e){
+        return exclusive_lock(this, execute(operation::lock_exclusive, {b, e}));
+    }
+
+    // Return an empty handle instead of waiting.
+
+    shared_lock try_lock_shared(size_type b, size_type e){
+        node_handle node = execute(operation::try_lock_shared, {b, e});
+        return node != nullptr ? shared_lock(this, node) : shared_lock();
+    }
+
+    exclusive_lock try_lock_exclusive(size_type b, size_type e){
+        node_handle node = execute(operation::try_lock_exclusive, {b, e});
+        return node != nullptr ? exclusive_lock(this, node) : exclusive_lock();
+    }
+
+    // Preallocate tree nodes for `n` more simultaneously held intervals.
+    void reserve(size_type n){
+        mtx.lock();
+        inter_tree.reserve(n);
+        combine_and_unlock();
+    }
+
+private:
+
+    enum class operation : unsigned char{
+        // The releases, applied first in every pass
+        unlock_shared,
+        unlock_exclusive,
+        downgrade,
+
+        lock_shared,
+        lock_exclusive,
+        try_lock_shared,
+        try_lock_exclusive,
+        upgrade
+    };
+
+    enum slot_state : int{
+        free,
+
+        // Being filled in by the thread that claimed it
+        claimed,
+
+        // Waiting for a combiner
+        pending,
+
+        // Seen by a combiner, but not granted. Only a pass that releases an overlapping interval tries again.
+        parked,
+
+        // `node` holds the result
+        done
+    };
+
+    // A published request, every slot on its own cache lines
+    struct alignas(64) Slot{
+        std::atomic<int> state{free};
+        operation op;
+        lock_tree::key_type key;
+
+        // The lock to release, upgrade or downgrade, and the result of the request
+        node_handle node = nullptr;
+    };
+
+    size_type slot_count_;
+    std::unique_ptr<Slot[]> slots_;
+
+    // A bit per slot, set while the slot is pending or parked, so a pass does not have to look at every slot
+    std::unique_ptr<std::atomic<std::uint64_t>[]> published_;
+
+    // Guards the tree, its owner is the combiner
+    std::mutex mtx;
+
+    // Signalled when inter_tree becomes empty (~combining_locker waits for it)
+    std::condition_variable cv;
+    lock_tree inter_tree;
+
+    // Slots in the pending state (counted right before they get there, so it never drops below 0)
+    std::atomic<size_type> pending_count_{0};
+
+    // The new and the parked requests of the current pass, and the intervals it released (guarded by mtx)
+    std::vector<Slot*> batch_;
+    std::vector<Slot*> parked_;
+    std::vector<lock_tree::key_type> released_;
+
+    static bool is_release(operation op){
+        return op <= operation::downgrade;
+    }
+
+    static bool is_blocking(operation op){
+        return op == operation::lock_shared || op == operation::lock_exclusive || op == operation::upgrade;
+    }
+
+    // Apply the request, or publish it and wait for its result
+    node_handle execute(operation op, lock_tree::key_type key, node_handle node = nullptr){
+
+        Slot* slot = nullptr;
+
+        if (mtx.try_lock()){
+            bool applied = apply(op, key, node);
+
+            // Has to wait, park it right away (nobody else combines meanwhile)
+            if (!applied && (slot = claim(true)) != nullptr){
+                fill(*slot, op, key, node, parked);
+            }
+
+            if (applied && is_release(op)){
+                released_.push_back(key);
+            }
+            combine_and_unlock();
+
+            if (applied){
+                return node;
+            }
+        }
+
+        if (slot == nullptr){
+            slot = claim(!is_blocking(op));
+
+            if (slot == nullptr){
+                // No free slot for a request that never waits, apply it once the mutex is free
+                mtx.lock();
+                apply(op, key, node);
+                if (is_release(op)){
+                    released_.push_back(key);
+                }
+                combine_and_unlock();
+                return node;
+            }
+
+            // Counted before it is published, a combiner taking it along must not count it out first
+            pending_count_.fetch_add(1, std::memory_order_seq_cst);
+            fill(*slot, op, key, node, pending);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        while (true){
+            int state = slot->state.load(std::memory_order_acquire);
+
+            if (state == done){
+                break;
+            }
+
+            // Combine, unless somebody else does. That one takes this request along, or finds it in
+            // pending_count_ after unlocking.
+            if (state == pending && mtx.try_lock()){
+                combine_and_unlock();
+                continue;
+            }
+
+            slot->state.wait(state, std::memory_order_acquire);
+        }
+
+        node = slot->node;
+        slot->state.store(free, std::memory_order_release);
+        return node;
+    }
+
+    void fill(Slot& slot, operation op, lock_tree::key_type key, node_handle node, slot_state state){
+        slot.op = op;
+        slot.key = key;
+        slot.node = node;
+        slot.state.store(state, std::memory_order_release);
+
+        size_type index = &slot - slots_.get();
+        published_[index / 64].fetch_or(std::uint64_t{1} << (index % 64), std::memory_order_release);
+    }
+
+    // Combine, then release the mutex. The threads of the requests published meanwhile saw the mutex taken and went
+    // to sleep, so whoever unlocks has to check for them (the mutex is taken only through here).
+    void combine_and_unlock(){
+        while (true){
+            combine();
+            mtx.unlock();
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (pending_count_.load(std::memory_order_relaxed) == 0 || !mtx.try_lock()){
+                return;
+            }
+        }
+    }
+
+    // A free slot, starting at the calling thread's own. Gives up after a full round if `may_fail`.
+    Slot* claim(bool may_fail){
+
+        static thread_local size_type hint = std::hash<std::thread::id>{}(std::this_thread::get_id());
+
+        while (true){
+            for (size_type i = 0; i < slot_count_; ++i){
+                Slot& slot = slots_[(hint + i) % slot_count_];
+
+                int expected = free;
+                if (slot.state.load(std::memory_order_relaxed) == free
+                    && slot.state.compare_exchange_strong(expected, claimed, std::memory_order_acquire)){
+                    return &slot;
+                }
+            }
+
+            if (may_fail){
+                return nullptr;
+            }
+
+            std::this_thread::yield();
+        }
+    }
+
+    // One pass over the published requests (under mtx): the new releases, the parked requests overlapping the
+    // intervals released by the pass (or by the request applied right before it), then the new acquisitions.
+    void combine(){
+
+        batch_.clear();
+        parked_.clear();
+        for (size_type word = 0; word * 64 < slot_count_; ++word){
+            for (std::uint64_t bits = published_[word].load(std::memory_order_acquire); bits != 0; bits &= bits - 1){
+                Slot* slot = &slots_[word * 64 + std::countr_zero(bits)];
+                (slot->state.load(std::memory_order_acquire) == pending ? batch_ : parked_).push_back(slot);
+            }
+        }
+
+        pending_count_.fetch_sub(batch_.size(), std::memory_order_relaxed);
+
+        // In key order, for the locality of the tree walks
+        auto by_key = [](const Slot* a, const Slot* b){ return a->key < b->key; };
+
+        auto acquisitions = std::partition(batch_.begin(), batch_.end(), [](const Slot* slot){ return is_release(slot->op); });
+        std::sort(batch_.begin(), acquisitions, by_key);
+        std::sort(acquisitions, batch_.end(), by_key);
+
+        for (auto it = batch_.begin(); it != acquisitions; ++it){
+            apply(**it);
+        }
+
+        if (!released_.empty()){
+            auto retried = std::partition(parked_.begin(), parked_.end(), [this](const Slot* slot){ return overlaps_released(slot->key); });
+            std::sort(parked_.begin(), retried, by_key);
+
+            for (auto it = parked_.begin(); it != retried; ++it){
+                apply(**it);
+            }
+        }
+
+        for (auto it = acquisitions; it != batch_.end(); ++it){
+            apply(**it);
+        }
+
+        released_.clear();
+
+        if (inter_tree.empty()){
+            cv.notify_all();
+        }
+    }
+
+    // Apply a published request and tell its thread whether it was granted or parked
+    void apply(Slot& slot){
+
+        if (!apply(slot.op, slot.key, slot.node)){
+            if (slot.state.load(std::memory_order_relaxed) == pending){
+                slot.state.store(parked, std::memory_order_release);
+                slot.state.notify_one();
+            }
+            return;
+        }
+
+        if (is_release(slot.op)){
+            released_.push_back(slot.key);
+        }
+
+        size_type index = &slot - slots_.get();
+        published_[index / 64].fetch_and(~(std::uint64_t{1} << (index % 64)), std::memory_order_relaxed);
+        slot.state.store(done, std::memory_order_release);
+        slot.state.notify_one();
+    }
+
+    bool overlaps_released(lock_tree::key_type key) const{
+        return std::any_of(released_.begin(), released_.end(), [&](lock_tree::key_type released){
+            return released.first < key.second && key.first < released.second;
+        });
+    }
+
+    // Apply one request to the tree, `node` receives the result. False if a blocking request has to wait.
+    bool apply(operation op, lock_tree::key_type key, node_handle& node){
+
+        switch (op){
+            case operation::unlock_shared:
+                node->value.counter--;
+                if (node->value.counter == 0){
+                    inter_tree.erase(node);
+                }
+                return true;
+
+            case operation::unlock_exclusive:
+                inter_tree.erase(node);
+                return true;
+
+            case operation::downgrade:
+                // Nothing overlaps an exclusive lock
+                node->value.is_exclusive = false;
+                inter_tree.refresh(node);
+                return true;
+
+            case operation::lock_shared:
+            case operation::try_lock_shared:
+                if (inter_tree.get_overlap_if(key, true) == inter_tree.end()){
+                    node = insert_shared(key);
+                    return true;
+                }
+                node = nullptr;
+                return op == operation::try_lock_shared;
+
+            case operation::lock_exclusive:
+            case operation::try_lock_exclusive:
+                if (inter_tree.get_overlap(key) == inter_tree.end()){
+                    node = inter_tree.emplace(key, LockInfo{1, true}).first;
+                    return true;
+                }
+                node = nullptr;
+                return op == operation::try_lock_exclusive;
+
+            case operation::upgrade:
+                // The last shared lock of the interval, and nothing else overlaps
+                if (node->value.counter == 1 && inter_tree.get_overlap(key, true) == inter_tree.end()){
+                    node->value.is_exclusive = true;
+                    inter_tree.refresh(node);
+                    return true;
+                }
+                return false;
+        }
+
+        return false;
+    }
+
+    node_handle insert_shared(lock_tree::key_type key){
+        auto [it, inserted] = inter_tree.emplace(key, LockInfo{1, false});
+        if (!inserted){
+            it->value.counter++;
+        }
+        return it;
+    }
+
+    void unlock_shared(node_handle it){
+        execute(operation::unlock_shared, it->key, it);
+    }
+
+    void unlock_exclusive(node_handle it){
+        execute(operation::unlock_exclusive, it->key, it);
+    }
+
+    exclusive_lock actual_upgrade(node_handle it){
+        return exclusive_lock(this, execute(operation::upgrade, it->key, it));
+    }
+
+    shared_lock actual_downgrade(node_handle it){
+        return shared_lock(this, execute(operation::downgrade, it->key, it));
+    }
+};
+
+#endif //INTERVAL_LOCK_COMBINING_LOCKER_HPP
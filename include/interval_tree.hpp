@@ -3,26 +3,33 @@
 
 #include <algorithm>
 #include <cassert>
+#include <iterator>
+#include <limits>
 #include <memory>
-#include <stack>
+#include <ranges>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-template<class Value>
+template<class Value, class Allocator = std::allocator<Value>>
 class interval_tree {
 public:
 	class node;
 
-	using node_ptr = std::unique_ptr<node>;
+	using node_ptr = node *;
 	using size_type = std::size_t;
 	using difference_type = std::ptrdiff_t;
 	using key_type = std::pair<size_type, size_type>;
 	using value_type = Value;
+	using allocator_type = Allocator;
 
 	class node {
 	public:
 		template<class ...Args>
 		node(key_type key, Args &&...args) noexcept
-			: key(key), maximum(key.second), value(std::forward<Args>(args)...), left(nullptr), right(nullptr), height(1) {}
+			: key(key), maximum(key.second), value(std::forward<Args>(args)...), parent(nullptr), left(nullptr), right(nullptr), height(1) {
+			exclusive_maximum = is_exclusive(value) ? key.second : 0;
+		}
 
 		void update_meta() noexcept {
 			update_height();
@@ -30,29 +37,228 @@ public:
 		}
 
 		void update_height() noexcept {
-			height = std::max(get_height(left.get()), get_height(right.get())) + 1;
+			height = std::max(get_height(left), get_height(right)) + 1;
 		}
 
 		void update_maximum() noexcept {
-			auto candidates = {get_maximum(left.get()), get_maximum(right.get()), key.second};
+			auto candidates = {get_maximum(left), get_maximum(right), key.second};
 			maximum = std::max(candidates);
+
+			auto exclusive_candidates = {get_exclusive_maximum(left), get_exclusive_maximum(right), is_exclusive(value) ? key.second : 0};
+			exclusive_maximum = std::max(exclusive_candidates);
 		}
 
 		key_type key;
 		size_type maximum;
+		size_type exclusive_maximum; // the maximum among the exclusive intervals only (0 if there are none)
 		value_type value;
+		node_ptr parent;
 		node_ptr left;
 		node_ptr right;
 		size_type height;
 	};
 
+	// the height of the tallest AVL tree that fits into the address space
+	// (the smallest AVL tree of height h has N(h) = N(h - 1) + N(h - 2) + 1 nodes)
+	static constexpr size_type max_height = [] {
+		size_type max_nodes = std::numeric_limits<size_type>::max() / sizeof(node);
+		size_type previous = 0, current = 1, height = 1;
+
+		while (current + previous + 1 <= max_nodes) {
+			size_type next = current + previous + 1;
+			previous = current;
+			current = next;
+			++height;
+		}
+
+		return height;
+	}();
+
+private:
+	// Resumable preorder DFS over the nodes overlapping `query`.
+	// The pending subtrees are at most one per level, so the traversal stack fits into a fixed buffer.
+	class overlap_cursor {
+	public:
+		overlap_cursor(node *root, key_type query, bool ignore_identity, bool exclusive_only = false) noexcept
+			: query_(query), ignore_identity_(ignore_identity), exclusive_only_(exclusive_only) {
+			push(root);
+		}
+
+		node *next() noexcept {
+			while (size_ > 0) {
+				node *current = traverse_[--size_];
+
+				if (query_.second <= current->key.first) {
+					// neither the node nor its right subtree can overlap
+					push(current->left);
+					continue;
+				}
+
+				// traverse the right subtree after the left one
+				push(current->right);
+				push(current->left);
+
+				if (query_.first < current->key.second && matches(current))
+					return current; // it overlaps
+			}
+
+			return nullptr;
+		}
+
+	private:
+		bool matches(node *n) const noexcept {
+			return (!exclusive_only_ || is_exclusive(n->value)) && (!ignore_identity_ || query_ != n->key);
+		}
+
+		void push(node *n) noexcept {
+			// the maximum in the subtree is too small -> cannot overlap
+			if (n == nullptr || (exclusive_only_ ? n->exclusive_maximum : n->maximum) <= query_.first)
+				return;
+
+			assert(size_ < max_height + 1);
+			traverse_[size_++] = n;
+		}
+
+		node *traverse_[max_height + 1];
+		size_type size_ = 0;
+		key_type query_;
+		bool ignore_identity_;
+		bool exclusive_only_;
+	};
+
+public:
+	class overlap_view : public std::ranges::view_interface<overlap_view> {
+	public:
+		class iterator {
+		public:
+			using value_type = node *;
+			using difference_type = std::ptrdiff_t;
+
+			iterator() noexcept = default;
+
+			explicit iterator(overlap_view *view) noexcept
+				: view_(view) {}
+
+			node *operator*() const noexcept {
+				return view_->current_;
+			}
+
+			iterator &operator++() noexcept {
+				view_->current_ = view_->cursor_.next();
+				return *this;
+			}
+
+			void operator++(int) noexcept {
+				++*this;
+			}
+
+			friend bool operator==(const iterator &it, std::default_sentinel_t) noexcept {
+				return it.at_end();
+			}
+
+		private:
+			// the hidden friend is not a member, it reads the view through here
+			bool at_end() const noexcept {
+				return view_->current_ == nullptr;
+			}
+
+			overlap_view *view_ = nullptr;
+		};
+
+		explicit overlap_view(overlap_cursor cursor) noexcept
+			: cursor_(cursor) {}
+
+		iterator begin() noexcept {
+			if (!started_) {
+				current_ = cursor_.next();
+				started_ = true;
+			}
+
+			return iterator(this);
+		}
+
+		std::default_sentinel_t end() const noexcept {
+			return std::default_sentinel;
+		}
+
+	private:
+		overlap_cursor cursor_;
+		node *current_ = nullptr;
+		bool started_ = false;
+	};
+
+	interval_tree() = default;
+
+	explicit interval_tree(const allocator_type &allocator) noexcept
+		: allocator_(allocator) {}
+
+	interval_tree(const interval_tree &) = delete;
+	interval_tree &operator=(const interval_tree &) = delete;
+
+	interval_tree(interval_tree &&other) noexcept
+		: allocator_(std::move(other.allocator_)), root_(std::exchange(other.root_, nullptr)) {}
+
+	interval_tree &operator=(interval_tree &&other) noexcept {
+		if (this != &other) {
+			clear();
+			allocator_ = std::move(other.allocator_);
+			root_ = std::exchange(other.root_, nullptr);
+		}
+
+		return *this;
+	}
+
+	~interval_tree() {
+		clear();
+	}
+
 	template<class ...Args>
-	std::pair<node *, bool> emplace(key_type key, Args &&...args) noexcept(noexcept(emplace_node(std::move(root_), key, std::forward<Args>(args)...))) {
+	std::pair<node *, bool> emplace(key_type key, Args &&...args) noexcept(noexcept(std::remove_reference_t<Value>(std::forward<Args>(args)...))) {
 		assert(key.first < key.second);
-		auto [new_root, result] = emplace_node(std::move(root_), key, std::forward<Args>(args)...);
 
-		root_ = std::move(new_root);
-		return result;
+		auto [parent, link] = find_link(key);
+		if (*link != nullptr)
+			return {*link, false};
+
+		// the constructor ensures that metainformation is correct
+		node *result = create_node(key, std::forward<Args>(args)...);
+		result->parent = parent;
+		*link = result;
+
+		retrace(parent);
+
+		return {result, true};
+	}
+
+	// links the node `n` taken out of a tree by extract, unless a node with its key is already there (then returns false)
+	bool insert(node *n) noexcept {
+		auto [parent, link] = find_link(n->key);
+		if (*link != nullptr)
+			return false;
+
+		n->parent = parent;
+		n->left = nullptr;
+		n->right = nullptr;
+		n->height = 1;
+		n->maximum = n->key.second;
+		n->exclusive_maximum = is_exclusive(n->value) ? n->key.second : 0;
+		*link = n;
+
+		retrace(parent);
+
+		return true;
+	}
+
+	// constructs a node without linking it, for insert into this tree or another one
+	template<class ...Args>
+	node *make_node(key_type key, Args &&...args) {
+		return create_node(key, std::forward<Args>(args)...);
+	}
+
+	// destroys a node taken out of a tree by extract (or never inserted) with the allocator of this tree
+	// (a node made by another tree may only be disposed of here if both trees share the allocator)
+	void dispose(node *n) noexcept {
+		destroy_node(n);
 	}
 
 	const node *find(key_type query) const noexcept {
@@ -62,12 +268,12 @@ public:
 	node *find(key_type query) noexcept {
 		assert(query.first < query.second);
 
-		node *current = root_.get();
+		node *current = root_;
 		while (current != nullptr) {
 			if (query < current->key)
-				current = current->left.get();
+				current = current->left;
 			else if (current->key < query)
-				current = current->right.get();
+				current = current->right;
 			else
 				break;
 		}
@@ -80,10 +286,10 @@ public:
 	}
 
 	node *find_min() noexcept {
-		if (root_.get() == nullptr)
+		if (root_ == nullptr)
 			return nullptr;
 		else
-			return find_min(root_.get());
+			return find_min(root_);
 	}
 
 	const node *end() const noexcept {
@@ -96,7 +302,110 @@ public:
 
 	void erase(key_type key) noexcept {
 		assert(key.first < key.second);
-		root_ = delete_node(std::move(root_), key);
+
+		node *n = find(key);
+		if (n != nullptr)
+			erase(n);
+	}
+
+	// erases the node without searching for it, the other nodes keep their addresses
+	void erase(node *n) noexcept {
+		extract(n);
+		destroy_node(n);
+	}
+
+	// unlinks the node without destroying it, it keeps its address (and value) until it is inserted into this tree or
+	// another one and erased there (see join for the allocators)
+	void extract(node *n) noexcept {
+		assert(n != nullptr);
+
+		node *parent = n->parent;
+
+		if (n->left == nullptr || n->right == nullptr) {
+			node *child = n->left != nullptr ? n->left : n->right;
+
+			replace_child(parent, n, child);
+			if (child != nullptr)
+				child->parent = parent;
+
+			retrace(parent);
+			return;
+		}
+
+		// relink the successor (it has no left child) into the place of `n`
+		node *successor = find_min(n->right);
+		node *retrace_from = successor;
+
+		if (successor != n->right) {
+			retrace_from = successor->parent;
+
+			retrace_from->left = successor->right;
+			if (successor->right != nullptr)
+				successor->right->parent = retrace_from;
+
+			successor->right = n->right;
+			successor->right->parent = successor;
+		}
+
+		successor->left = n->left;
+		successor->left->parent = successor;
+
+		successor->parent = parent;
+		replace_child(parent, n, successor);
+
+		successor->height = n->height;
+		successor->maximum = n->maximum;
+		successor->exclusive_maximum = n->exclusive_maximum;
+
+		retrace(retrace_from);
+
+		// the retracing might have stopped below the successor, whose key differs from the erased one
+		if (retrace_from != successor)
+			retrace(successor);
+	}
+
+	// moves the nodes with keys not less than `at` into the empty tree `other`, in O(log n);
+	// the nodes keep their addresses (see join for the allocators)
+	void split(key_type at, interval_tree &other) noexcept {
+		assert(other.empty());
+
+		node *tree = std::exchange(root_, nullptr);
+		auto [left, right] = split(tree, at);
+
+		root_ = left;
+		other.root_ = right;
+	}
+
+	// moves all the nodes of `other` into this tree, in O(log n); all the keys of one of the trees have to be
+	// less than all the keys of the other one. The nodes keep their addresses and are later deallocated by the
+	// allocator of this tree, so with an allocator that does not always compare equal, that allocator has to be
+	// able to deallocate them (a pool_allocator can, as long as the pool the nodes came from outlives them).
+	void join(interval_tree &other) noexcept {
+		node *left = std::exchange(root_, nullptr);
+		node *right = std::exchange(other.root_, nullptr);
+
+		if (left != nullptr && right != nullptr && find_min(right)->key < find_min(left)->key)
+			std::swap(left, right);
+
+		root_ = join(left, right);
+	}
+
+	// destroys all the nodes, the memory stays with the allocator
+	void clear() noexcept {
+		destroy_subtree(root_);
+		root_ = nullptr;
+	}
+
+	// preallocates storage for `n` more nodes (if the allocator supports it)
+	void reserve(size_type n) {
+		if constexpr (requires(node_allocator_type &allocator) { allocator.reserve(n); })
+			allocator_.reserve(n);
+	}
+
+	// propagates a change of `n->value` that affects its exclusivity
+	void refresh(node *n) noexcept {
+		assert(n != nullptr);
+		retrace(n);
 	}
 
 	const node *get_overlap(key_type query, bool ignore_identity = false) const noexcept {
@@ -106,32 +415,37 @@ public:
 	node *get_overlap(key_type query, bool ignore_identity = false) noexcept {
 		assert(query.first < query.second);
 
-		std::stack<node *> traverse;
-		traverse.push(root_.get());
+		return overlap_cursor(root_, query, ignore_identity).next();
+	}
 
-		while (!traverse.empty()) {
-			node *current = traverse.top();
-			traverse.pop();
+	const node *get_overlap_if(key_type query, bool exclusive_only, bool ignore_identity = false) const noexcept {
+		return const_cast<const node *>(const_cast<interval_tree *>(this)->get_overlap_if(query, exclusive_only, ignore_identity));
+	}
 
-			if (current == nullptr || current->maximum <= query.first) {
-				// the maximum in the subtree is too small -> cannot overlap
-				continue;
-			}
+	// like get_overlap, but if `exclusive_only` is set, only the exclusive intervals are considered,
+	// the subtrees without an overlapping exclusive interval are pruned as a whole
+	node *get_overlap_if(key_type query, bool exclusive_only, bool ignore_identity = false) noexcept {
+		assert(query.first < query.second);
 
-			if (current->key.first < query.second) {
-				// it might overlap (it also makes sense to traverse the right subtree)
+		if (!exclusive_only)
+			return get_overlap(query, ignore_identity);
 
-				if (query.first < current->key.second) {
-					if (!ignore_identity || query != current->key)
-						return current; // it overlaps
-				}
+		if (ignore_identity)
+			return overlap_cursor(root_, query, ignore_identity, true).next();
 
-				// traverse the right subtree
-				traverse.push(current->right.get());
-			}
+		// Single descent: if the left subtree contains an exclusive interval ending after `query.first`
+		// and none of them overlaps, they all start after `query`, and so does the whole right subtree.
+		node *current = root_;
+		while (current != nullptr && query.first < current->exclusive_maximum) {
+			if (is_exclusive(current->value) && current->key.first < query.second && query.first < current->key.second)
+				return current;
 
-			// traverse the left subtree
-			traverse.push(current->left.get());
+			if (query.first < get_exclusive_maximum(current->left))
+				current = current->left;
+			else if (current->key.first < query.second)
+				current = current->right;
+			else
+				break;
 		}
 
 		return nullptr;
@@ -142,34 +456,56 @@ public:
 
 		std::vector<node *> result;
 
-		std::stack<node *> traverse;
-		traverse.push(root_.get());
+		overlap_cursor cursor(root_, query, ignore_identity);
+		while (node *current = cursor.next())
+			result.emplace_back(current);
 
-		while (!traverse.empty()) {
-			node *current = traverse.top();
-			traverse.pop();
+		return result;
+	}
+
+	// calls `visitor(node *)` for every overlapping node (in preorder), without allocating;
+	// if the visitor returns bool, returning false stops the walk (then for_each_overlap returns false as well)
+	template<class Visitor>
+	bool for_each_overlap(key_type query, Visitor &&visitor, bool ignore_identity = false) noexcept(std::is_nothrow_invocable_v<Visitor &, node *>) {
+		assert(query.first < query.second);
 
-			if (current == nullptr || current->maximum <= query.first) {
-				// the maximum in the subtree is too small -> cannot overlap
-				continue;
+		overlap_cursor cursor(root_, query, ignore_identity);
+		while (node *current = cursor.next()) {
+			if constexpr (std::is_convertible_v<std::invoke_result_t<Visitor &, node *>, bool>) {
+				if (!visitor(current))
+					return false;
+			} else {
+				visitor(current);
 			}
+		}
 
-			if (current->key.first < query.second) {
-				// it might overlap (it also makes sense to traverse the right subtree)
+		return true;
+	}
 
-				if (query.first < current->key.second)
-					if (!ignore_identity || query != current->key)
-						result.emplace_back(current); // it overlaps
+	// like for_each_overlap, but if `exclusive_only` is set, only the exclusive intervals are visited
+	template<class Visitor>
+	bool for_each_overlap_if(key_type query, bool exclusive_only, Visitor &&visitor) noexcept(std::is_nothrow_invocable_v<Visitor &, node *>) {
+		assert(query.first < query.second);
 
-				// traverse the right subtree
-				traverse.push(current->right.get());
+		overlap_cursor cursor(root_, query, false, exclusive_only);
+		while (node *current = cursor.next()) {
+			if constexpr (std::is_convertible_v<std::invoke_result_t<Visitor &, node *>, bool>) {
+				if (!visitor(current))
+					return false;
+			} else {
+				visitor(current);
 			}
-
-			// traverse the left subtree
-			traverse.push(current->left.get());
 		}
 
-		return result;
+		return true;
+	}
+
+	// lazy single-pass view of the overlapping nodes, the traversal state lives inside the view
+	// (the tree must not be modified while the view is in use)
+	overlap_view overlaps(key_type query, bool ignore_identity = false) noexcept {
+		assert(query.first < query.second);
+
+		return overlap_view(overlap_cursor(root_, query, ignore_identity));
 	}
 
 	bool empty() const noexcept {
@@ -177,10 +513,13 @@ public:
 	}
 
 	size_type height() const noexcept {
-		return get_height(root_.get());
+		return get_height(root_);
 	}
 
 private:
+	using node_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<node>;
+	using node_allocator_traits = std::allocator_traits<node_allocator_type>;
+
 	static size_type get_height(node *n) noexcept {
 		if (n == nullptr)
 			return 0;
@@ -195,158 +534,264 @@ private:
 			return n->maximum;
 	}
 
+	static size_type get_exclusive_maximum(node *n) noexcept {
+		if (n == nullptr)
+			return 0;
+		else
+			return n->exclusive_maximum;
+	}
+
+	// values with an `is_exclusive` member take part in the exclusive augmentation
+	static bool is_exclusive(const value_type &value) noexcept {
+		if constexpr (requires { static_cast<bool>(value.is_exclusive); })
+			return static_cast<bool>(value.is_exclusive);
+		else
+			return false;
+	}
+
 	static difference_type get_balance_factor(node *n) noexcept {
 		if (n == nullptr)
 			return 0;
 		else {
-			size_type left_height = get_height(n->left.get());
-			size_type right_height = get_height(n->right.get());
+			size_type left_height = get_height(n->left);
+			size_type right_height = get_height(n->right);
 
 			return (difference_type)left_height - (difference_type)right_height;
 		}
 	}
 
-	static node_ptr rotate_right(node_ptr old_root) noexcept {
+	void replace_child(node *parent, node *old_child, node *new_child) noexcept {
+		if (parent == nullptr)
+			root_ = new_child;
+		else if (parent->left == old_child)
+			parent->left = new_child;
+		else
+			parent->right = new_child;
+	}
+
+	node_ptr rotate_right(node_ptr old_root) noexcept {
 		assert(old_root != nullptr); // the root has to exist
 		assert(old_root->left != nullptr); // the root's left child has to exist (new root)
 
-		node_ptr new_root = std::move(old_root->left);
+		node_ptr new_root = old_root->left;
 
 		// update old_root
-		old_root->left = std::move(new_root->right);
+		old_root->left = new_root->right;
+		if (old_root->left != nullptr)
+			old_root->left->parent = old_root;
 		old_root->update_meta();
 
 		// update new_root
-		new_root->right = std::move(old_root);
+		new_root->parent = old_root->parent;
+		replace_child(old_root->parent, old_root, new_root);
+		new_root->right = old_root;
+		old_root->parent = new_root;
 		new_root->update_meta();
 
 		return new_root;
 	}
 
-	static node_ptr rotate_left(node_ptr old_root) noexcept {
+	node_ptr rotate_left(node_ptr old_root) noexcept {
 		assert(old_root != nullptr); // the root has to exist
 		assert(old_root->right != nullptr); // the root's right child has to exist (new root)
 
-		node_ptr new_root = std::move(old_root->right);
+		node_ptr new_root = old_root->right;
 
 		// update old_root
-		old_root->right = std::move(new_root->left);
+		old_root->right = new_root->left;
+		if (old_root->right != nullptr)
+			old_root->right->parent = old_root;
 		old_root->update_meta();
 
 		// update new_root
-		new_root->left = std::move(old_root);
+		new_root->parent = old_root->parent;
+		replace_child(old_root->parent, old_root, new_root);
+		new_root->left = old_root;
+		old_root->parent = new_root;
 		new_root->update_meta();
 
 		return new_root;
 	}
 
-	template<class ...Args>
-	static std::pair<node_ptr, std::pair<node *, bool>> emplace_node(node_ptr root, key_type key, Args &&...args) noexcept(noexcept(std::remove_reference_t<Value>(std::forward<Args>(args)...))) {
-		std::pair<node *, bool> result;
+	// restores the AVL property of `root` (whose subtrees are balanced), returns the new root of the subtree
+	node_ptr rebalance(node_ptr root) noexcept {
+		difference_type balanceFactor = get_balance_factor(root);
+		if (balanceFactor > 1) {
+			if (get_balance_factor(root->left) < 0) {
+				rotate_left(root->left);
+			}
 
-		if (root == nullptr) {
-			// the constructor ensures that metainformation is correct
-			auto ptr = std::make_unique<node>(key, std::forward<Args>(args)...);
-			node *it = ptr.get();
+			return rotate_right(root);
+		} else if (balanceFactor < -1) {
+			if (get_balance_factor(root->right) > 0) {
+				rotate_right(root->right);
+			}
 
-			return {std::move(ptr), std::pair{it, true}};
+			return rotate_left(root);
+		} else {
+			return root;
 		}
+	}
 
-		if (key < root->key) {
-			auto [new_left, new_result] = emplace_node(std::move(root->left), key, std::forward<Args>(args)...);
-			root->left = std::move(new_left);
-			result = new_result;
+	// walks from `n` towards the root updating metainformation and rebalancing,
+	// stops as soon as a subtree keeps its height and its maximums (its ancestors are then unaffected)
+	void retrace(node_ptr n) noexcept {
+		while (n != nullptr) {
+			size_type old_height = n->height;
+			size_type old_maximum = n->maximum;
+			size_type old_exclusive_maximum = n->exclusive_maximum;
 
-			if (!new_result.second)
-				return {std::move(root), new_result};
-		} else if (key > root->key) {
-			auto [new_right, new_result] = emplace_node(std::move(root->right), key, std::forward<Args>(args)...);
-			root->right = std::move(new_right);
-			result = new_result;
+			n->update_meta();
+			n = rebalance(n);
 
-			if (!new_result.second)
-				return {std::move(root), new_result};
-		} else {
-			auto it = root.get();
+			if (n->height == old_height && n->maximum == old_maximum && n->exclusive_maximum == old_exclusive_maximum)
+				break;
 
-			return {std::move(root), std::pair{it, false}};
+			n = n->parent;
 		}
+	}
 
-		// Update the balance factor of each node and balance the tree
-		root->update_meta();
+	template<class ...Args>
+	node *create_node(key_type key, Args &&...args) {
+		node *n = node_allocator_traits::allocate(allocator_, 1);
+
+		try {
+			node_allocator_traits::construct(allocator_, n, key, std::forward<Args>(args)...);
+		} catch (...) {
+			node_allocator_traits::deallocate(allocator_, n, 1);
+			throw;
+		}
 
-		difference_type balanceFactor = get_balance_factor(root.get());
-		if (balanceFactor > 1) {
-			if (key > root->left->key) {
-				root->left = rotate_left(std::move(root->left));
-			}
+		return n;
+	}
 
-			return {rotate_right(std::move(root)), result};
-		} else if (balanceFactor < -1) {
-			if (key < root->right->key) {
-				root->right = rotate_right(std::move(root->right));
-			}
+	void destroy_node(node *n) noexcept {
+		node_allocator_traits::destroy(allocator_, n);
+		node_allocator_traits::deallocate(allocator_, n, 1);
+	}
 
-			return {rotate_left(std::move(root)), result};
-		} else {
-			return {std::move(root), result};
+	void destroy_subtree(node *n) noexcept {
+		if (n == nullptr)
+			return;
+
+		destroy_subtree(n->left);
+		destroy_subtree(n->right);
+		destroy_node(n);
+	}
+
+	// joins the detached subtrees `left` < `pivot` < `right` (the pivot is a detached single node), returns the new root;
+	// the rotations and the retracing work on `root_`, so it is used as scratch (and is left pointing at the result)
+	node *join(node *left, node *pivot, node *right) noexcept {
+		size_type left_height = get_height(left);
+		size_type right_height = get_height(right);
+
+		pivot->parent = nullptr;
+
+		if (left_height <= right_height + 1 && right_height <= left_height + 1) {
+			pivot->left = left;
+			pivot->right = right;
+			if (left != nullptr)
+				left->parent = pivot;
+			if (right != nullptr)
+				right->parent = pivot;
+
+			pivot->update_meta();
+			return root_ = pivot;
 		}
+
+		// descend the spine of the taller tree to a subtree that is at most one level taller than the other tree,
+		// put the pivot in its place and retrace from there
+		bool left_taller = left_height > right_height;
+		node *shorter = left_taller ? right : left;
+		size_type shorter_height = get_height(shorter);
+
+		root_ = left_taller ? left : right;
+		node *parent = nullptr;
+		node *current = root_;
+		while (get_height(current) > shorter_height + 1) {
+			parent = current;
+			current = left_taller ? current->right : current->left;
+		}
+
+		pivot->left = left_taller ? current : shorter;
+		pivot->right = left_taller ? shorter : current;
+		if (pivot->left != nullptr)
+			pivot->left->parent = pivot;
+		if (pivot->right != nullptr)
+			pivot->right->parent = pivot;
+
+		pivot->parent = parent;
+		(left_taller ? parent->right : parent->left) = pivot;
+		pivot->update_meta();
+
+		retrace(parent);
+		return root_;
 	}
 
-	static node *find_min(node *n) noexcept {
-		assert(n != nullptr);
+	// joins the detached subtrees `left` < `right`, returns the new root
+	node *join(node *left, node *right) noexcept {
+		if (left == nullptr)
+			return right;
+		if (right == nullptr)
+			return left;
 
-		while (n->left != nullptr)
-			n = n->left.get();
+		// detach the minimum of `right` to become the pivot
+		root_ = right;
+		node *pivot = find_min(right);
 
-		return n;
+		replace_child(pivot->parent, pivot, pivot->right);
+		if (pivot->right != nullptr)
+			pivot->right->parent = pivot->parent;
+		retrace(pivot->parent);
+
+		return join(left, pivot, root_);
 	}
 
-	node_ptr delete_node(node_ptr root, key_type key) noexcept {
-		// Find the node and delete it
-		if (root == nullptr)
-			return root;
-	
-		if (key < root->key) {
-			root->left = delete_node(std::move(root->left), key);
-		} else if (key > root->key) {
-			root->right = delete_node(std::move(root->right), key);
-		} else if ((root->left == nullptr) || (root->right == nullptr)) {
-			root = std::move(root->left ? root->left : root->right);
-
-			if (root == nullptr) {
-				return nullptr;
-			}
+	// splits the detached subtree `tree` into the nodes with keys less than `at` and the rest
+	std::pair<node *, node *> split(node *tree, key_type at) noexcept {
+		if (tree == nullptr)
+			return {nullptr, nullptr};
+
+		node *left = tree->left;
+		node *right = tree->right;
+		if (left != nullptr)
+			left->parent = nullptr;
+		if (right != nullptr)
+			right->parent = nullptr;
+
+		if (tree->key < at) {
+			auto [less, rest] = split(right, at);
+			return {join(left, tree, less), rest};
 		} else {
-			node *temp = find_min(root->right.get());
-			std::swap(root->key, temp->key);
-			std::swap(root->value, temp->value);
-			root->right = delete_node(std::move(root->right), temp->key);
+			auto [less, rest] = split(left, at);
+			return {less, join(rest, tree, right)};
 		}
+	}
 
-		assert(root != nullptr);
+	// the parent and the link a node with `key` belongs to, the link points at the node with `key` if there is one
+	std::pair<node *, node **> find_link(key_type key) noexcept {
+		node *parent = nullptr;
+		node **link = &root_;
 
-		root->update_meta();
+		while (*link != nullptr && (*link)->key != key) {
+			parent = *link;
+			link = key < parent->key ? &parent->left : &parent->right;
+		}
 
-		difference_type balanceFactor = get_balance_factor(root.get());
-		if (balanceFactor > 1) {
-			if (get_balance_factor(root->left.get()) < 0) {
-				root->left = rotate_left(std::move(root->left));
-			}
+		return {parent, link};
+	}
 
-			return rotate_right(std::move(root));
-		} else if (balanceFactor < -1) {
-			if (get_balance_factor(root->right.get()) > 0) {
-				root->right = rotate_right(std::move(root->right));
-			}
+	static node *find_min(node *n) noexcept {
+		assert(n != nullptr);
 
-			return rotate_left(std::move(root));
-		} else {
-			return root;
-		}
+		while (n->left != nullptr)
+			n = n->left;
+
+		return n;
 	}
 
-	node_ptr root_;
+	[[no_unique_address]] node_allocator_type allocator_;
+	node_ptr root_ = nullptr;
 };
 
 #endif // INTERVAL_TREE_HPP_
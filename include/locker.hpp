@@ -1,371 +1,2365 @@
 #ifndef INTERVAL_LOCK_LOCKER_HPP
 #define INTERVAL_LOCK_LOCKER_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <mutex>
+#include <memory>
+#include <span>
+#include <stop_token>
 #include <condition_variable>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "basic_lock.hpp"
 #include "interval_tree.hpp"
+#include "pool_allocator.hpp"
 
-class locker;
-class exclusive_lock;
+// Fairness policies of basic_locker. They decide whether the waiting requests can hold back a request whose interval is otherwise free.
 
-class shared_lock {
+// A request waits only for the conflicting locks that are held. This is the original behaviour: a steady stream of overlapping shared locks can starve an exclusive one.
+struct reader_preferring{};
 
+// A shared request also waits while an overlapping exclusive request (or upgrade) is waiting. Readers holding a lock must not request another overlapping shared lock while a writer waits.
+struct writer_preferring{};
+
+// A request also waits for the overlapping conflicting requests that arrived earlier, so conflicting requests are granted in their arrival order (blocking becomes transitive).
+struct fifo_per_overlap{};
+
+// How a blocked lock_shared/lock_exclusive/upgrade waits for the conflicting locks to be released.
+enum class wait_strategy{
+
+    // Park on a condition variable right away
+    park,
+
+    // Spin (with the mutex released) for about twice the average wait of the locker, then park. Long waits make the
+    // average exceed max_spin and nobody spins any more, on a single CPU nobody spins at all.
+    spin_then_park,
+
+    // Park right away, the releasing thread grants the lock on the waiter's behalf and wakes exactly that thread, which
+    // returns without taking the mutex again. The releasing thread cannot barge back in ahead of the waiters, but a contended
+    // acquisition always waits for the woken thread to run. Upgrades and lock_many re-check their predicates anyway.
+    handoff
+};
+
+// Mutex guards the critical section, any Lockable (with std::condition_variable_any in place of std::condition_variable).
+template<class FairnessPolicy = reader_preferring, class Mutex = std::mutex>
+class basic_locker;
+
+// Default executor of the async_lock_* awaitables: the coroutine is resumed right away, on the thread that granted the lock
+// (the one releasing the conflicting lock, after it has left the critical section).
+struct inline_executor{
+    void operator()(std::coroutine_handle<> handle) const{
+        handle.resume();
+    }
+};
+
+using locker = basic_locker<>;
+
+// One range of a lock_many() request
+struct range_request{
+    std::size_t begin;
+    std::size_t end;
+    bool is_exclusive;
+};
+
+// Interval node that will be added to the interval tree
+struct LockInfo{
+
+    // Counter to keep track of the reference count of an interval
+    std::size_t counter;
+
+    // is_exclusive used to determine if a lock is exclusive or shared
+    bool is_exclusive;
+
+    // The thread that took an exclusive lock through lock_exclusive() (0 if unknown), the owner of a covering lock
+    std::size_t owner = 0;
+
+    // A covering lock stands for the escalated locks of its owner (the counter counts their nodes), which are kept out of the tree
+    bool is_cover = false;
+    bool is_escalated = false;
+
+    // A shared lock kept out of the tree behind the segment covering it
+    bool is_coalesced = false;
+};
+
+using lock_tree = interval_tree<LockInfo, pool_allocator<LockInfo>>;
+
+// Intent and update locks over one interval, in a tree of their own (lock_tree keeps the shared and exclusive ones)
+struct IntentInfo{
+
+    // Holders per lock_mode
+    std::size_t holders[6];
+
+    // An intent exclusive or shared intent exclusive lock is held, so the interval conflicts with shared locks
+    // (the tree keeps track of these like of the exclusive locks)
+    bool is_exclusive;
+};
+
+using intent_lock_tree = interval_tree<IntentInfo, pool_allocator<IntentInfo>>;
+
+// Tree nodes keep their addresses until they are erased, so a lock can refer to its interval directly.
+using shared_lock = basic_shared_lock<locker, lock_tree::node*>;
+using lock_set = basic_lock_set<locker, lock_tree::node*>;
+using exclusive_lock = basic_exclusive_lock<locker, lock_tree::node*>;
+using intent_lock = basic_intent_lock<locker, intent_lock_tree::node*>;
+
+template<class FairnessPolicy, class Mutex>
+class basic_locker {
 public:
 
-    using interval = std::pair<std::size_t , std::size_t>;
 
-    shared_lock() noexcept {
-        p_MainLocker = nullptr;
-        interval_={0,0};
+    using shared_lock = basic_shared_lock<basic_locker, lock_tree::node*>;
+    using exclusive_lock = basic_exclusive_lock<basic_locker, lock_tree::node*>;
+    using lock_set = basic_lock_set<basic_locker, lock_tree::node*>;
+    using intent_lock = basic_intent_lock<basic_locker, intent_lock_tree::node*>;
+
+    // Allow class exclusive_lock and class shared_lock to access the private members/methods of this class.
+    friend exclusive_lock;
+    friend shared_lock;
+    friend lock_set;
+    friend intent_lock;
+
+    // The partitions of a sharded locker are lockers, it works with their critical sections directly.
+    template<class, class> friend class basic_sharded_locker;
+
+    using size_type = std::size_t;
+    using node_handle = lock_tree::node*;
+
+    using fairness_policy = FairnessPolicy;
+    using mutex_type = Mutex;
+
+    template<class Lock, class Executor>
+    class lock_awaiter;
+
+    // The longest a waiter spins before it parks (wait_strategy::spin_then_park)
+    static constexpr std::chrono::nanoseconds max_spin{50'000};
+
+    basic_locker() = default;
+
+    explicit basic_locker(wait_strategy strategy)
+        : strategy_(strategy) {}
+
+    basic_locker(const basic_locker&) = delete;
+    basic_locker(basic_locker&&) = delete;
+    basic_locker& operator=(const basic_locker&) = delete;
+    basic_locker& operator=(basic_locker&&) = delete;
+
+    ~basic_locker(){
+        wait_until_idle();
+    }
+
+    shared_lock lock_shared(size_type b, size_type e) {
+        return acquire_shared(b, e, park_forever{});
+    }
+
+    exclusive_lock lock_exclusive(size_type b, size_type e){
+        return acquire_exclusive(b, e, park_forever{});
+    }
+
+    // Like the above, but return an empty handle as soon as a stop is requested on `token`.
+
+    shared_lock lock_shared(size_type b, size_type e, std::stop_token token){
+        return until_stopped(token, [&](auto park){ return acquire_shared(b, e, park); });
+    }
+
+    exclusive_lock lock_exclusive(size_type b, size_type e, std::stop_token token){
+        return until_stopped(token, [&](auto park){ return acquire_exclusive(b, e, park); });
+    }
+
+    // The try_lock_* variants return an empty handle instead of waiting (or after waiting until the deadline).
+
+    shared_lock try_lock_shared(size_type b, size_type e) {
+        return acquire_shared(b, e, dont_park{});
+    }
+
+    template<class Rep, class Period>
+    shared_lock try_lock_shared_for(size_type b, size_type e, const std::chrono::duration<Rep, Period>& timeout) {
+        return try_lock_shared_until(b, e, std::chrono::steady_clock::now() + timeout);
+    }
+
+    template<class Clock, class Duration>
+    shared_lock try_lock_shared_until(size_type b, size_type e, const std::chrono::time_point<Clock, Duration>& deadline) {
+        return acquire_shared(b, e, park_until<Clock, Duration>{deadline});
+    }
+
+    exclusive_lock try_lock_exclusive(size_type b, size_type e) {
+        return acquire_exclusive(b, e, dont_park{});
+    }
+
+    template<class Rep, class Period>
+    exclusive_lock try_lock_exclusive_for(size_type b, size_type e, const std::chrono::duration<Rep, Period>& timeout) {
+        return try_lock_exclusive_until(b, e, std::chrono::steady_clock::now() + timeout);
+    }
+
+    template<class Clock, class Duration>
+    exclusive_lock try_lock_exclusive_until(size_type b, size_type e, const std::chrono::time_point<Clock, Duration>& deadline) {
+        return acquire_exclusive(b, e, park_until<Clock, Duration>{deadline});
+    }
+
+    // Acquire all the `requests` or none of them: the thread waits (holding nothing) until every range is free at the same time,
+    // so locking several ranges cannot deadlock. The ranges of one request must not conflict with each other.
+    lock_set lock_many(std::span<const range_request> requests){
+        return acquire_many(requests, park_forever{});
+    }
+
+    lock_set try_lock_many(std::span<const range_request> requests){
+        return acquire_many(requests, dont_park{});
+    }
+
+    // Intent and update locks, `mode` is any lock_mode but shared and exclusive (lock_shared and lock_exclusive). Two
+    // locks conflict if their ranges overlap and lock_modes_compatible() says so, except that the intent locks (IS, IX,
+    // SIX) are a level above the shared, exclusive and update locks strictly inside their ranges, which never conflict
+    // with them. So a scan takes IS (or SIX, if it updates some of what it reads) over the whole range and shared locks
+    // on its parts as it goes, writers take IX over the whole range and exclusive locks on their parts, and both only
+    // wait for each other on the parts; a lock over the whole range (or partially overlapping it) conflicts with them.
+    // A reader which might write takes U in place of a shared lock: only one U is held over a range at a time, so its
+    // upgrade() cannot deadlock with another one. Intent locks are meant to be few and coarse, the checks of the other
+    // requests visit the overlapping ones (a shared request only the IX and SIX ones). The fairness policies do not
+    // know about the levels, with writer_preferring and fifo_per_overlap a request can wait behind an overlapping
+    // intent request it is compatible with (until that one is granted).
+    intent_lock lock_intent(size_type b, size_type e, lock_mode mode){
+        return acquire_intent(b, e, mode, park_forever{});
+    }
+
+    intent_lock try_lock_intent(size_type b, size_type e, lock_mode mode){
+        return acquire_intent(b, e, mode, dont_park{});
+    }
+
+    // co_await-able variants: a contended request suspends the coroutine instead of blocking the thread.
+    // Once the lock is granted, the coroutine is handed to `executor` (any callable taking a std::coroutine_handle<>)
+    // and the co_await expression yields the lock. The locker must outlive the pending requests.
+
+    template<class Executor = inline_executor>
+    lock_awaiter<shared_lock, Executor> async_lock_shared(size_type b, size_type e, Executor executor = {}){
+        return {this, {b, e}, std::move(executor)};
+    }
+
+    template<class Executor = inline_executor>
+    lock_awaiter<exclusive_lock, Executor> async_lock_exclusive(size_type b, size_type e, Executor executor = {}){
+        return {this, {b, e}, std::move(executor)};
+    }
+
+    // Optimistic reads (seqlock style). read_version() neither locks [b, e) nor takes the mutex, validate() tells whether an
+    // exclusive lock over the range was held at any time since. The data read in between may be torn (read it with
+    // relaxed atomics or copy it) and may only be used once validate() returned true, otherwise read it again or take a
+    // shared lock. An empty token means an exclusive lock is held right now.
+    //
+    // Exclusive locks are counted in version_stripe_count stripes of keys (k belongs to stripe (k >> version_stripe_shift)
+    // modulo the count), so an exclusive lock close to the range can fail the validation as well. The stripes are
+    // allocated (under the mutex) by the first read_version() call, the exclusive locks do not maintain them before.
+
+    struct version_token{
+        size_type b = 0;
+        size_type e = 0;
+        std::uint64_t version = 0;
+        bool valid = false;
+
+        explicit operator bool() const noexcept{
+            return valid;
+        }
+    };
+
+    static constexpr size_type version_stripe_count = 64;
+    static constexpr unsigned version_stripe_shift = 6;
+
+    version_token read_version(size_type b, size_type e){
+        assert(b < e);
+
+        const VersionStripe* stripes = stripes_.load(std::memory_order_acquire);
+        if (stripes == nullptr){
+            stripes = enable_versions();
+        }
+
+        version_token token{b, e, 0, true};
+        for_each_stripe({b, e}, [&](size_type i){
+            auto word = stripes[i].word.load(std::memory_order_acquire);
+            token.valid = token.valid && (word & writers_mask) == 0;
+            token.version += word;
+        });
+        return token;
+    }
+
+    bool validate(const version_token& token) const{
+        if (!token){
+            return false;
+        }
+
+        // The reads of the data come before the versions are read again
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        const VersionStripe* stripes = stripes_.load(std::memory_order_relaxed);
+        std::uint64_t version = 0;
+        for_each_stripe({token.b, token.e}, [&](size_type i){
+            version += stripes[i].word.load(std::memory_order_relaxed);
+        });
+
+        // A word only grows, by at least writer_released per exclusive lock and release
+        return version == token.version;
+    }
+
+    // Biased readers (BRAVO style). Once an interval has been locked promote_threshold times with exactly the same
+    // bounds, all of them shared (and no request waits for an overlapping lock), it becomes hot: the locker keeps its
+    // node in the tree and lock_shared() on these bounds only publishes the node in a slot of the visible readers table
+    // (picked by thread and node), without the mutex. An exclusive request or an upgrade overlapping a hot interval revokes the bias:
+    // the readers in the table are counted into the node, and the interval needs promote_threshold more locks to become
+    // hot again. A shared lock released by another thread than the one that took it also revokes the bias.
+
+    static constexpr size_type hot_interval_count = 16;
+    static constexpr size_type reader_slot_count = 1024;
+    static constexpr size_type promote_threshold = 64;
+
+    // Whether lock_shared(b, e) takes the biased path right now (for tests and diagnostics)
+    bool is_biased(size_type b, size_type e) const{
+        const HotTables* tables = hot_.load(std::memory_order_acquire);
+        if (tables == nullptr){
+            return false;
+        }
+
+        const HotInterval& hot = tables->hot[hot_index({b, e})];
+        return hot.biased.load() && hot.b.load(std::memory_order_relaxed) == b && hot.e.load(std::memory_order_relaxed) == e;
+    }
+
+    // Dedicated locks. An interval locked promote_threshold times with exactly the same bounds, exclusive at least once
+    // (a read-only one becomes biased instead), gets a reader-writer lock of its own while the caller is its only holder:
+    // the node stays in the tree once, and lock_shared()/lock_exclusive() on these bounds only take the dedicated lock,
+    // without the mutex and without touching the tree (a blocked one waits on the dedicated lock as well). Any other
+    // request overlapping the interval demotes it first, as do a timed or cancellable request on these bounds that has to
+    // wait, an upgrade and a downgrade: its holders become ordinary locks in the node. So does frequency: every
+    // demote_interval locks taken through the mutex, a dedicated lock taken fewer than promote_threshold times since is
+    // demoted.
+
+    static constexpr size_type demote_interval = 1024;
+
+    // Whether lock_shared(b, e)/lock_exclusive(b, e) take the dedicated lock right now (for tests and diagnostics)
+    bool is_dedicated(size_type b, size_type e) const{
+        const HotTables* tables = hot_.load(std::memory_order_acquire);
+        if (tables == nullptr){
+            return false;
+        }
+
+        const DedicatedLock& dedicated = tables->dedicated[hot_index({b, e})];
+        return (dedicated.state.load() & dedicated_closed) == 0 && dedicated.b.load() == b && dedicated.e.load() == e;
+    }
+
+    // Lock escalation. Once a thread holds escalation_threshold exclusive locks taken by lock_exclusive() within one region
+    // (the keys k with the same k >> escalation_region_shift) and no other lock or waiter overlaps the range from the first
+    // to the last of them, its locks leave the tree and a single covering exclusive lock stands for them there: the handles
+    // keep working, and the other requests search a smaller tree. The owner's later requests inside the covering lock are
+    // only checked against its escalated locks, and its exclusive ones right next to it extend it. Any other request
+    // overlapping the covering lock (or one of the owner's partially overlapping it, an upgrade or a downgrade of an
+    // escalated lock) puts the locks back into the tree first, so nobody ever waits for the covering lock itself.
+
+    static constexpr size_type escalation_threshold = 64;
+    static constexpr unsigned escalation_region_shift = 32;
+
+    // Whether [b, e) lies within a covering lock right now (for tests and diagnostics)
+    bool is_escalated(size_type b, size_type e){
+        std::unique_lock<mutex_type> lock(mtx);
+        node_handle cover = find_cover({b, e});
+        return cover != nullptr && cover->key.first <= b && e <= cover->key.second;
+    }
+
+    // Coalesced readers. Shared locks from lock_shared() that overlap or touch leave the tree, and one segment standing
+    // for their union is checked instead of each of them.
+
+    // Whether [b, e) lies within a segment right now (for tests and diagnostics)
+    bool is_coalesced(size_type b, size_type e){
+        std::unique_lock<mutex_type> lock(mtx);
+        node_handle segment = segments.get_overlap({b, e});
+        return segment != nullptr && segment->key.first <= b && e <= segment->key.second;
+    }
+
+    // Preallocate tree nodes for `n` more simultaneously held intervals.
+    // Nodes of unlocked intervals are recycled, so once the pool covers the working set, locking and unlocking never touch the global heap.
+    void reserve(size_type n){
+        std::unique_lock<mutex_type> lock(mtx);
+        inter_tree.reserve(n);
+    }
+
+private:
+
+    // Wait until the trees are empty (the hot intervals and the dedicated ones do not keep their nodes any more).
+    void wait_until_idle(){
+        std::unique_lock<mutex_type> lock(mtx);
+        revoke_overlapping({0, std::numeric_limits<size_type>::max()});
+        demote_overlapping({0, std::numeric_limits<size_type>::max()});
+        cv.wait(lock, [this] { return idle(); });
+    }
+
+    struct Waiter;
+
+    struct WaiterList{
+        Waiter* head;
+        Waiter* tail;
+        std::size_t exclusive_count;
+
+        // Some of the waiters are exclusive (the tree keeps track of the exclusive maximum)
+        bool is_exclusive;
+    };
+
+    using waiter_tree = interval_tree<WaiterList, pool_allocator<WaiterList>>;
+
+    // A blocked thread parks on its own record: on `signal` (a futex), or on its condition variable if it needs a timeout.
+    using condition_type = std::conditional_t<std::is_same_v<Mutex, std::mutex>, std::condition_variable, std::condition_variable_any>;
+
+    struct Waiter{
+        condition_type cv;
+
+        // Arrival order of the request
+        std::uint64_t ticket;
+        bool is_exclusive;
+
+        // Waiters for the same interval form a doubly linked list
+        Waiter* prev = nullptr;
+        Waiter* next = nullptr;
+        waiter_tree::node* node = nullptr;
+
+        // Set for a suspended coroutine, and for a thread waiting for a plain lock_shared/lock_exclusive with
+        // wait_strategy::handoff. Neither re-checks a predicate: whoever wakes it up grants the lock on its behalf (into
+        // `granted`) and queues it up, `resume` is called once the mutex is released. A thread handed its lock that way
+        // returns without taking the mutex again.
+        void (*resume)(Waiter&) = nullptr;
+        lock_tree::key_type key;
+        node_handle granted = nullptr;
+        Waiter* next_granted = nullptr;
+
+        // The wakeup pass that notified the waiter last
+        std::uint64_t woken = 0;
+
+        // How the waiter was woken up, watched without the mutex (by a parked or spinning thread).
+        // notified is stored under the mutex, granting and handed_over by unpark() after the grant.
+        enum : std::uint32_t{ idle, notified, granting, handed_over };
+        std::atomic<std::uint32_t> signal{idle};
+    };
+
+    mutex_type mtx;
+
+    // Signalled when the trees become empty (~basic_locker waits for it, see idle)
+    condition_type cv;
+    lock_tree inter_tree;
+    intent_lock_tree intents;
+
+    // The escalated locks, each one within the covering lock of its owner in inter_tree. The nodes move between the two
+    // trees, inter_tree allocates and frees all of them (so none piles up in the pool of the side tree).
+    lock_tree escalated;
+
+    // The coalesced shared locks, and the disjoint segments standing for them
+    lock_tree coalesced;
+    lock_tree segments;
+
+    // Scratch space of coalesce() and split_segment(), kept to spare the allocations
+    std::vector<node_handle> coalesce_scratch_;
+    std::vector<lock_tree::key_type> covered_scratch_;
+
+    // Waiters are indexed by the interval they wait for, so a release only wakes the waiters whose interval overlaps the released one.
+    waiter_tree waiters;
+    std::uint64_t next_ticket = 0;
+
+    // Suspended coroutines collected by notify_overlapping(), the ones grant_candidates() granted a lock, waiting for resume_granted()
+    Waiter* candidates = nullptr;
+    Waiter** candidates_tail = &candidates;
+    Waiter* granted_head = nullptr;
+    std::uint64_t wake_pass = 1;
+
+    wait_strategy strategy_ = wait_strategy::park;
+
+    // Per stripe: the exclusive locks held over its keys (low half) plus a version (high half) that grows with each of them
+    // and each release. A reader checks that the count is 0 and that the sum of the words did not change.
+    struct alignas(64) VersionStripe{
+        std::atomic<std::uint64_t> word{0};
+    };
+
+    static constexpr std::uint64_t writers_mask = 0xffff'ffff;
+    static constexpr std::uint64_t writer_acquired = (std::uint64_t{1} << 32) + 1;
+    static constexpr std::uint64_t writer_released = (std::uint64_t{1} << 32) - 1;
+
+    // Published once the stripes are maintained, written under the mutex
+    std::unique_ptr<VersionStripe[]> stripe_storage_;
+    std::atomic<VersionStripe*> stripes_{nullptr};
+
+    // A hot interval, at the index of its bounds. Bound (under the mutex) to the node it keeps in the tree: node, bounds,
+    // then a new generation, then biased. A biased reader checks that the generation did not change.
+    struct alignas(64) HotInterval{
+        std::atomic<bool> biased{false};
+        std::atomic<std::uint64_t> generation{0};
+        std::atomic<size_type> b{0};
+        std::atomic<size_type> e{0};
+        std::atomic<node_handle> node{nullptr};
+    };
+
+    static constexpr std::uint64_t dedicated_readers = (std::uint64_t{1} << 24) - 1;
+    static constexpr std::uint64_t dedicated_writer_waiting = std::uint64_t{1} << 24;
+    static constexpr std::uint64_t dedicated_writers_waiting = ((std::uint64_t{1} << 16) - 1) << 24;
+    static constexpr std::uint64_t dedicated_writer = std::uint64_t{1} << 40;
+    static constexpr std::uint64_t dedicated_closed = std::uint64_t{1} << 41;
+    static constexpr std::uint64_t dedicated_generation = std::uint64_t{1} << 42;
+
+    // A dedicated lock, at the index of its bounds. `state` holds the holders (the readers' count or the writer flag),
+    // the writers waiting for it, whether the lock is closed (not bound, or demoted), and a generation in the high bits,
+    // so a lock taken or released through a binding cannot succeed on the next one. Bound (under the mutex): node,
+    // bounds, then the state of the new generation. `uses` counts the locks taken since the last frequency check.
+    struct alignas(64) DedicatedLock{
+        std::atomic<std::uint64_t> state{dedicated_closed};
+        std::atomic<std::uint32_t> waiting{0};
+        std::atomic<size_type> uses{0};
+        std::atomic<size_type> b{0};
+        std::atomic<size_type> e{0};
+        std::atomic<node_handle> node{nullptr};
+    };
+
+    // Acquisitions through the mutex per bounds, the candidates for promotion (guarded by the mutex)
+    struct AccessCount{
+        lock_tree::key_type key{0, 0};
+        size_type hits = 0;
+        bool exclusive = false;
+    };
+
+    // Every slot holding a node stands for one shared lock on it, besides the ones in its counter
+    struct HotTables{
+        HotInterval hot[hot_interval_count];
+        std::atomic<node_handle> readers[reader_slot_count] = {};
+        DedicatedLock dedicated[hot_interval_count];
+        AccessCount counts[hot_interval_count * 4];
+        size_type accesses = 0;
+    };
+
+    // Allocated by the first lock taken through the mutex (under the mutex)
+    std::unique_ptr<HotTables> hot_storage_;
+    std::atomic<HotTables*> hot_{nullptr};
+    size_type biased_count_ = 0;
+    size_type dedicated_count_ = 0;
+
+    // Roughly the exclusive locks an owner holds in the tree per region, since the last escalation check (a covering lock
+    // counts as one), and the range they were taken within. Guarded by the mutex.
+    struct EscalationCount{
+        size_type owner = 0;
+        size_type region = 0;
+        size_type locks = 0;
+        lock_tree::key_type span{};
+    };
+
+    static constexpr size_type escalation_slot_count = 16;
+    EscalationCount escalation_counts_[escalation_slot_count];
+
+    // The covering locks in inter_tree
+    size_type cover_count_ = 0;
+
+    // Scratch space of escalate() and deescalate(), kept to spare the allocations
+    std::vector<node_handle> escalation_scratch_;
+
+    // Moving average of how long the waits of this locker took (wait_strategy::spin_then_park).
+    // Also updated by threads handed their lock without the mutex, a lost update does not matter.
+    std::atomic<std::chrono::nanoseconds> average_wait_{std::chrono::nanoseconds{0}};
+
+    // How wait() parks a waiter, returns false once the waiter should give up.
+
+    // The thread sleeps on `signal`, and keeps the mutex released if it was handed its lock.
+    struct park_forever{
+        bool operator()(Waiter& self, std::unique_lock<mutex_type>& lock) const{
+            lock.unlock();
+            self.signal.wait(Waiter::idle, std::memory_order_acquire);
+
+            if (self.signal.load(std::memory_order_acquire) < Waiter::granting){
+                lock.lock();
+            }
+            return true;
+        }
+    };
+
+    // Never registered as a waiter at all
+    struct dont_park{
+        bool operator()(Waiter&, std::unique_lock<mutex_type>&) const{
+            return false;
+        }
+    };
+
+    template<class Clock, class Duration>
+    struct park_until{
+        std::chrono::time_point<Clock, Duration> deadline;
+
+        bool operator()(Waiter& self, std::unique_lock<mutex_type>& lock) const{
+            return self.cv.wait_until(lock, deadline) == std::cv_status::no_timeout;
+        }
+    };
+
+    // Parks until notified or until a stop is requested, the stop callback wakes up the waiter found in `parked`.
+    struct park_until_stopped{
+        std::stop_token token;
+        Waiter** parked;
+
+        bool operator()(Waiter& self, std::unique_lock<mutex_type>& lock) const{
+            if (token.stop_requested()){
+                return false;
+            }
+
+            // Takes the mutex again even if handed its lock, the stop callback must not find the record any more
+            *parked = &self;
+            lock.unlock();
+            self.signal.wait(Waiter::idle, std::memory_order_acquire);
+            lock.lock();
+            *parked = nullptr;
+
+            return !token.stop_requested();
+        }
+    };
+
+    // Calls `acquire` with the parking functor for `token`.
+    template<class Acquire>
+    auto until_stopped(std::stop_token token, Acquire acquire){
+
+        if (!token.stop_possible()){
+            return acquire(park_forever{});
+        }
+
+        Waiter* parked = nullptr;
+
+        // Created before and destroyed after the critical section: a running callback needs the mutex,
+        // and destroying the callback waits for it to finish.
+        std::stop_callback wake(token, [this, &parked]{
+            std::unique_lock<mutex_type> lock(mtx);
+            // A granted waiter is already being woken up, by unpark()
+            if (parked != nullptr && parked->granted == nullptr){
+                parked->signal.store(Waiter::notified, std::memory_order_release);
+                parked->signal.notify_one();
+            }
+        });
+
+        return acquire(park_until_stopped{token, &parked});
+    }
+
+    static size_type hot_index(lock_tree::key_type key){
+        return (key.first * 0x9e3779b97f4a7c15 ^ key.second) * 0xff51afd7ed558ccd >> 40 & (hot_interval_count - 1);
+    }
+
+    // The slot of the calling thread for `node`
+    static size_type reader_slot(node_handle node){
+        static thread_local const size_type self = std::hash<std::thread::id>{}(std::this_thread::get_id()) * 0x9e3779b97f4a7c15;
+        return (self ^ reinterpret_cast<std::uintptr_t>(node) >> 6) * 0xff51afd7ed558ccd >> 40 & (reader_slot_count - 1);
+    }
+
+    // The biased path of lock_shared(), nullptr if [b, e) is not hot (or the slot is taken).
+    node_handle try_lock_biased(lock_tree::key_type key){
+        HotTables* tables = hot_.load(std::memory_order_acquire);
+        if (tables == nullptr){
+            return nullptr;
+        }
+
+        HotInterval& hot = tables->hot[hot_index(key)];
+        auto generation = hot.generation.load();
+        if (!hot.biased.load() || hot.b.load() != key.first || hot.e.load() != key.second){
+            return nullptr;
+        }
+
+        node_handle node = hot.node.load();
+        auto& slot = tables->readers[reader_slot(node)];
+        node_handle expected = nullptr;
+        if (!slot.compare_exchange_strong(expected, node)){
+            return nullptr;
+        }
+
+        // Either the revoking thread sees the slot, or we see the revocation
+        if (hot.biased.load() && hot.generation.load() == generation){
+            return node;
+        }
+
+        expected = node;
+        if (!slot.compare_exchange_strong(expected, nullptr)){
+            // The slot was counted into the node in the meantime (or taken by a release on it), release that lock
+            std::unique_lock<mutex_type> lock(mtx);
+            unlock_shared(node, lock);
+        }
+        return nullptr;
+    }
+
+    // The biased path of unlock_shared(): give up a slot holding the node, if the calling thread's one does.
+    bool try_unlock_biased(node_handle it){
+        HotTables* tables = hot_.load(std::memory_order_acquire);
+        if (tables == nullptr){
+            return false;
+        }
+
+        auto& slot = tables->readers[reader_slot(it)];
+        node_handle expected = it;
+        return slot.load(std::memory_order_relaxed) == it && slot.compare_exchange_strong(expected, nullptr);
+    }
+
+    // Under the mutex, after a lock on `key` was inserted (as `it`) by the slow path.
+    void count_access(node_handle it, lock_tree::key_type key, bool is_exclusive){
+        HotTables* tables = hot_.load(std::memory_order_relaxed);
+        if (tables == nullptr){
+            hot_storage_ = std::make_unique<HotTables>();
+            tables = hot_storage_.get();
+            hot_.store(tables, std::memory_order_release);
+        }
+
+        if (++tables->accesses % demote_interval == 0){
+            demote_unused(*tables);
+        }
+
+        AccessCount& count = tables->counts[(hot_index(key) * 4 + (key.first ^ key.second) % 4) % (hot_interval_count * 4)];
+        if (count.key != key){
+            count = {key, 0, false};
+        }
+        count.exclusive = count.exclusive || is_exclusive;
+
+        // Nobody may wait for an overlapping lock, they do not revoke the bias (or demote the dedicated lock) any more
+        HotInterval& hot = tables->hot[hot_index(key)];
+        if (++count.hits < promote_threshold || hot.node.load(std::memory_order_relaxed) != nullptr || waiters.get_overlap(key) != waiters.end()){
+            return;
+        }
+
+        if (count.exclusive){
+            if (promote_dedicated(tables->dedicated[hot_index(key)], it, is_exclusive)){
+                count = {key, 0, false};
+            }
+            return;
+        }
+        count.hits = 0;
+
+        // The hot interval keeps the node. The caller's lock becomes the node's own count, and moves to the caller's slot
+        // (else its release would revoke the bias right away).
+        node_handle expected = nullptr;
+        if (!tables->readers[reader_slot(it)].compare_exchange_strong(expected, it)){
+            it->value.counter++;
+        }
+        hot.node.store(it, std::memory_order_relaxed);
+        hot.b.store(key.first, std::memory_order_relaxed);
+        hot.e.store(key.second, std::memory_order_relaxed);
+        hot.generation.fetch_add(1);
+        hot.biased.store(true);
+        ++biased_count_;
+    }
+
+    // Under the mutex, before an exclusive lock or an upgrade over `key` is checked (or an intent lock, which keeps the
+    // hot intervals below it).
+    void revoke_overlapping(lock_tree::key_type key, bool keep_below = false){
+        if (biased_count_ == 0){
+            return;
+        }
+
+        for (HotInterval& hot : hot_.load(std::memory_order_relaxed)->hot){
+            lock_tree::key_type hot_key{hot.b.load(std::memory_order_relaxed), hot.e.load(std::memory_order_relaxed)};
+            if (hot.biased.load(std::memory_order_relaxed) && hot_key.first < key.second && key.first < hot_key.second && !(keep_below && is_below(hot_key, key))){
+                revoke(hot);
+            }
+        }
+    }
+
+    // Under the mutex, by a release that found no slot: the lock might be in a slot of another thread.
+    void revoke_node(node_handle it){
+        if (biased_count_ == 0){
+            return;
+        }
+
+        HotInterval& hot = hot_.load(std::memory_order_relaxed)->hot[hot_index(it->key)];
+        if (hot.biased.load(std::memory_order_relaxed) && hot.node.load(std::memory_order_relaxed) == it){
+            revoke(hot);
+        }
+    }
+
+    // There are no waiters overlapping a hot interval, so the node can be erased without waking anybody.
+    void revoke(HotInterval& hot){
+        hot.biased.store(false);
+        --biased_count_;
+
+        // Count the readers into the node, then drop the node's own count
+        node_handle node = hot.node.load(std::memory_order_relaxed);
+        for (auto& slot : hot_.load(std::memory_order_relaxed)->readers){
+            node_handle expected = node;
+            if (slot.load() == node && slot.compare_exchange_strong(expected, nullptr)){
+                node->value.counter++;
+            }
+        }
+
+        hot.node.store(nullptr, std::memory_order_relaxed);
+        hot.generation.fetch_add(1);
+
+        if (--node->value.counter == 0){
+            erase(node);
+        }
+    }
+
+    // Under the mutex: the caller's lock becomes the first holder of a dedicated lock for its interval, if it is the only one
+    // there. The node is shared in the tree from now on and counts 1 for the binding, an exclusive holder keeps its versions
+    // counted (the release through the dedicated lock counts it out).
+    bool promote_dedicated(DedicatedLock& dedicated, node_handle it, bool is_exclusive){
+        if (dedicated.node.load(std::memory_order_relaxed) != nullptr || it->value.counter != 1 || inter_tree.get_overlap(it->key, true) != inter_tree.end()
+            || segments.get_overlap(it->key) != segments.end() || !compatible_with_intents(it->key, lock_mode::exclusive)){
+            return false;
+        }
+
+        if (is_exclusive){
+            it->value.is_exclusive = false;
+            inter_tree.refresh(it);
+        }
+
+        dedicated.node.store(it);
+        dedicated.b.store(it->key.first);
+        dedicated.e.store(it->key.second);
+        dedicated.uses.store(0, std::memory_order_relaxed);
+
+        // The writers still waiting since the last binding leave on their own
+        auto state = dedicated.state.load();
+        while (!dedicated.state.compare_exchange_weak(state, (state / dedicated_generation + 1) * dedicated_generation
+                                                              + (state & dedicated_writers_waiting) + (is_exclusive ? dedicated_writer : 1))){
+        }
+        ++dedicated_count_;
+        return true;
+    }
+
+    // The dedicated path of lock_shared()/lock_exclusive(). Returns the node, or nullptr with `fallback` set if the
+    // request has to take the mutex: [b, e) is not dedicated, or it is taken and `park` cannot wait on it for good.
+    template<class Park>
+    node_handle try_lock_dedicated(lock_tree::key_type key, bool is_exclusive, Park, bool& fallback){
+        fallback = true;
+        HotTables* tables = hot_.load(std::memory_order_acquire);
+        if (tables == nullptr){
+            return nullptr;
+        }
+
+        DedicatedLock& dedicated = tables->dedicated[hot_index(key)];
+        auto state = dedicated.state.load();
+        if ((state & dedicated_closed) != 0){
+            return nullptr;
+        }
+
+        // Loaded before the lock is taken: if the stripes appear afterwards, the lock is demoted first and counted by then
+        VersionStripe* stripes = is_exclusive ? stripes_.load(std::memory_order_acquire) : nullptr;
+
+        // A waiting writer holds the readers back, unless the policy prefers them
+        constexpr bool prefers_writers = !std::is_same_v<FairnessPolicy, reader_preferring>;
+        bool registered = false;
+
+        node_handle it = nullptr;
+        while (true){
+            if ((state & dedicated_closed) != 0 || dedicated.b.load() != key.first || dedicated.e.load() != key.second){
+                break;
+            }
+
+            bool taken = is_exclusive ? (state & (dedicated_writer | dedicated_readers)) != 0
+                                      : (state & dedicated_writer) != 0 || (prefers_writers && (state & dedicated_writers_waiting) != 0);
+            if (!taken){
+                // The node of the generation in `state`, if the lock is taken on it. A waiting writer stops waiting as it takes it.
+                node_handle node = dedicated.node.load();
+                auto desired = state + (is_exclusive ? dedicated_writer : 1) - (registered && is_exclusive ? dedicated_writer_waiting : 0);
+                if (dedicated.state.compare_exchange_weak(state, desired)){
+                    dedicated.uses.fetch_add(1, std::memory_order_relaxed);
+                    if (stripes != nullptr){
+                        bump_stripes(stripes, key, true);
+                    }
+                    fallback = false;
+                    it = node;
+                    break;
+                }
+                continue;
+            }
+
+            if constexpr (std::is_same_v<Park, dont_park>){
+                fallback = false;
+                break;
+            }
+            else if constexpr (!std::is_same_v<Park, park_forever>){
+                break;
+            }
+            else{
+                if (!registered){
+                    // A writer waits in the state, so the readers it holds back see it go (they wait for a change of the state)
+                    if (is_exclusive){
+                        if ((state & dedicated_writers_waiting) == dedicated_writers_waiting){
+                            break;
+                        }
+                        if (!dedicated.state.compare_exchange_weak(state, state + dedicated_writer_waiting)){
+                            continue;
+                        }
+                        state += dedicated_writer_waiting;
+                    }
+                    registered = true;
+                    dedicated.waiting.fetch_add(1);
+                }
+                dedicated.state.wait(state);
+                state = dedicated.state.load();
+            }
+        }
+
+        if (registered){
+            if (is_exclusive && it == nullptr){
+                dedicated.state.fetch_sub(dedicated_writer_waiting);
+            }
+            if (dedicated.waiting.fetch_sub(1) != 1 && is_exclusive && it == nullptr){
+                dedicated.state.notify_all();
+            }
+        }
+        return it;
+    }
+
+    // The dedicated path of unlock_shared()/unlock_exclusive(), false once the lock is not dedicated (any more).
+    // The holders are all readers or the writer, so the state tells which one is released.
+    bool try_unlock_dedicated(node_handle it){
+        HotTables* tables = hot_.load(std::memory_order_acquire);
+        if (tables == nullptr){
+            return false;
+        }
+
+        DedicatedLock& dedicated = tables->dedicated[hot_index(it->key)];
+        VersionStripe* stripes = stripes_.load(std::memory_order_acquire);
+        auto state = dedicated.state.load();
+        do{
+            if ((state & dedicated_closed) != 0 || dedicated.node.load() != it){
+                return false;
+            }
+        } while (!dedicated.state.compare_exchange_weak(state, state - ((state & dedicated_writer) != 0 ? dedicated_writer : 1)));
+
+        if ((state & dedicated_writer) != 0 && stripes != nullptr){
+            bump_stripes(stripes, it->key, false);
+        }
+        if (dedicated.waiting.load() != 0){
+            dedicated.state.notify_all();
+        }
+        return true;
+    }
+
+    // Under the mutex, before any other request over `key` is checked (an intent request keeps the dedicated locks below it).
+    void demote_overlapping(lock_tree::key_type key, bool keep_below = false){
+        if (dedicated_count_ == 0){
+            return;
+        }
+
+        for (DedicatedLock& dedicated : hot_.load(std::memory_order_relaxed)->dedicated){
+            lock_tree::key_type dedicated_key{dedicated.b.load(std::memory_order_relaxed), dedicated.e.load(std::memory_order_relaxed)};
+            if (dedicated.node.load(std::memory_order_relaxed) != nullptr && dedicated_key.first < key.second && key.first < dedicated_key.second
+                && !(keep_below && is_below(dedicated_key, key))){
+                demote(dedicated);
+            }
+        }
+    }
+
+    // Under the mutex, before an upgrade or a downgrade of a lock on `it`.
+    void demote_node(node_handle it){
+        if (dedicated_count_ == 0){
+            return;
+        }
+
+        DedicatedLock& dedicated = hot_.load(std::memory_order_relaxed)->dedicated[hot_index(it->key)];
+        if (dedicated.node.load(std::memory_order_relaxed) == it){
+            demote(dedicated);
+        }
+    }
+
+    // Under the mutex, every demote_interval locks taken through it.
+    void demote_unused(HotTables& tables){
+        if (dedicated_count_ == 0){
+            return;
+        }
+
+        for (DedicatedLock& dedicated : tables.dedicated){
+            if (dedicated.node.load(std::memory_order_relaxed) != nullptr && dedicated.uses.exchange(0, std::memory_order_relaxed) < promote_threshold){
+                demote(dedicated);
+            }
+        }
+    }
+
+    // Closing the lock fixes its holders, they release through the mutex from now on. Like a hot interval, a dedicated one
+    // has no waiters overlapping it in the tree, so the node can be erased without waking anybody.
+    void demote(DedicatedLock& dedicated){
+        auto state = dedicated.state.fetch_or(dedicated_closed);
+        node_handle it = dedicated.node.load(std::memory_order_relaxed);
+        dedicated.node.store(nullptr);
+        --dedicated_count_;
+
+        // The node's count of 1 (for the binding) becomes the writer, or the readers' count
+        if ((state & dedicated_writer) != 0){
+            it->value.is_exclusive = true;
+            inter_tree.refresh(it);
+        }
+        else if ((state & dedicated_readers) != 0){
+            it->value.counter = state & dedicated_readers;
+        }
+        else{
+            erase(it);
+        }
+
+        // The threads waiting on the lock take the mutex now
+        if (dedicated.waiting.load() != 0){
+            dedicated.state.notify_all();
+        }
+    }
+
+    // The calling thread, as the owner of its exclusive locks (never 0, and never reused by a later thread)
+    static size_type current_owner(){
+        static std::atomic<size_type> next_owner{1};
+        static thread_local const size_type self = next_owner.fetch_add(1, std::memory_order_relaxed);
+        return self;
+    }
+
+    // Under the mutex, after an exclusive lock on `key` was inserted (as `it`) by lock_exclusive() through the mutex.
+    void count_escalation(node_handle it, lock_tree::key_type key){
+
+        // A dedicated lock now
+        if (!it->value.is_exclusive){
+            return;
+        }
+
+        size_type owner = current_owner();
+        it->value.owner = owner;
+
+        size_type region = key.first >> escalation_region_shift;
+        if ((key.second - 1) >> escalation_region_shift != region){
+            return;
+        }
+
+        EscalationCount& count = escalation_count(owner, region);
+        if (count.owner != owner || count.region != region || count.locks == 0){
+            count = {owner, region, 0, key};
+        }
+        count.span = {std::min(count.span.first, key.first), std::max(count.span.second, key.second)};
+        if (++count.locks >= escalation_threshold){
+            count.locks = escalate(owner, region, count.span) ? 1 : 0;
+        }
+    }
+
+    EscalationCount& escalation_count(size_type owner, size_type region){
+        return escalation_counts_[(owner ^ region * 0x9e3779b97f4a7c15) * 0xff51afd7ed558ccd >> 40 & (escalation_slot_count - 1)];
+    }
+
+    // Under the mutex, when an exclusive lock of a known owner leaves the tree.
+    void uncount_escalation(node_handle it){
+        size_type region = it->key.first >> escalation_region_shift;
+        EscalationCount& count = escalation_count(it->value.owner, region);
+        if (count.owner == it->value.owner && count.region == region && count.locks > 0){
+            --count.locks;
+        }
+    }
+
+    // Under the mutex: the owner's exclusive locks within `region` overlapping `span`, the range its counted locks were
+    // taken within (an earlier covering lock counts as one), move to the side tree behind a covering lock, if there are
+    // escalation_threshold of them and nobody else is in the way.
+    bool escalate(size_type owner, size_type region, lock_tree::key_type span){
+        size_type first = region << escalation_region_shift;
+        size_type last = first | ((size_type{1} << escalation_region_shift) - 1);
+        lock_tree::key_type region_key{first, last == std::numeric_limits<size_type>::max() ? last : last + 1};
+
+        auto owns = [&](node_handle it){
+            return it->value.is_exclusive && it->value.owner == owner && region_key.first <= it->key.first && it->key.second <= region_key.second;
+        };
+
+        escalation_scratch_.clear();
+        lock_tree::key_type cover{std::numeric_limits<size_type>::max(), 0};
+        inter_tree.for_each_overlap(span, [&](node_handle it){
+            if (owns(it)){
+                escalation_scratch_.push_back(it);
+                cover = {std::min(cover.first, it->key.first), std::max(cover.second, it->key.second)};
+            }
+        });
+
+        // The hot and dedicated intervals keep shared nodes in the tree, they are in the way as well
+        if (escalation_scratch_.size() < escalation_threshold || !inter_tree.for_each_overlap(cover, owns) || segments.get_overlap(cover) != segments.end()
+            || waiters.get_overlap(cover) != waiters.end() || !compatible_with_intents(cover, lock_mode::exclusive)){
+            return false;
+        }
+
+        size_type count = 0;
+        for (node_handle it : escalation_scratch_){
+            if (it->value.is_cover){
+                count += it->value.counter;
+                --cover_count_;
+                erase(it);
+                continue;
+            }
+
+            inter_tree.extract(it);
+            it->value.is_escalated = true;
+            [[maybe_unused]] bool inserted = escalated.insert(it);
+            assert(inserted);
+            ++count;
+        }
+
+        bump_versions(cover, true);
+        inter_tree.emplace(cover, LockInfo{count, true, owner, true});
+        ++cover_count_;
+        return true;
+    }
+
+    // Under the mutex: the covering lock overlapping `key`, if a key within one is given.
+    node_handle find_cover(lock_tree::key_type key){
+        if (cover_count_ == 0){
+            return nullptr;
+        }
+
+        node_handle it = inter_tree.get_overlap_if(key, true);
+        return it != nullptr && it->value.is_cover ? it : nullptr;
+    }
+
+    // Under the mutex, a request of the calling thread within one of its covering locks is only checked against the
+    // escalated locks there, and inserted into the side tree. So is an exclusive one right next to a covering lock (in its
+    // region) if nothing else overlaps it, the covering lock grows over it. Returns nullptr if the request takes the usual path.
+    node_handle try_lock_escalated(lock_tree::key_type key, bool is_exclusive){
+        if (cover_count_ == 0){
+            return nullptr;
+        }
+
+        node_handle cover = find_cover(key);
+        if (cover == nullptr){
+            cover = is_exclusive ? extend_cover(key) : nullptr;
+            if (cover == nullptr){
+                return nullptr;
+            }
+        }
+        else if (cover->value.owner != current_owner() || key.first < cover->key.first || cover->key.second < key.second
+                 || escalated.get_overlap_if(key, !is_exclusive) != escalated.end()
+                 || !compatible_with_intents(key, is_exclusive ? lock_mode::exclusive : lock_mode::shared)){
+            return nullptr;
+        }
+
+        if (is_exclusive){
+            bump_versions(key, true);
+        }
+
+        if (node_handle it = escalated.find(key)){
+            it->value.counter++;
+            return it;
+        }
+
+        node_handle it = inter_tree.make_node(key, LockInfo{1, is_exclusive, is_exclusive ? cover->value.owner : 0, false, true});
+        escalated.insert(it);
+        cover->value.counter++;
+        return it;
+    }
+
+    // Under the mutex: the calling thread's covering lock right next to `key` grows over it, see try_lock_escalated.
+    node_handle extend_cover(lock_tree::key_type key){
+        node_handle cover = key.first > 0 ? find_cover({key.first - 1, key.first}) : nullptr;
+        if (cover == nullptr || cover->key.second != key.first){
+            cover = key.second < std::numeric_limits<size_type>::max() ? find_cover({key.second, key.second + 1}) : nullptr;
+            if (cover == nullptr || cover->key.first != key.second){
+                return nullptr;
+            }
+        }
+
+        lock_tree::key_type extended{std::min(cover->key.first, key.first), std::max(cover->key.second, key.second)};
+        if (cover->value.owner != current_owner() || extended.first >> escalation_region_shift != (extended.second - 1) >> escalation_region_shift
+            || inter_tree.get_overlap(key) != inter_tree.end() || segments.get_overlap(key) != segments.end()
+            || waiters.get_overlap(key) != waiters.end() || !compatible_with_intents(key, lock_mode::exclusive)){
+            return nullptr;
+        }
+
+        // The stripes count the covering lock over its new bounds
+        bump_versions(cover->key, false);
+        inter_tree.extract(cover);
+        cover->key = extended;
+        [[maybe_unused]] bool inserted = inter_tree.insert(cover);
+        assert(inserted);
+        bump_versions(extended, true);
+        return cover;
+    }
+
+    // Under the mutex. Nobody waits for an overlapping lock while the covering lock is there, so it goes (with its last
+    // escalated lock) without waking anybody.
+    void unlock_escalated(node_handle it){
+        if (it->value.is_exclusive){
+            bump_versions(it->key, false);
+        }
+        if (--it->value.counter != 0){
+            return;
+        }
+
+        node_handle cover = find_cover(it->key);
+        escalated.extract(it);
+        inter_tree.dispose(it);
+        if (--cover->value.counter == 0){
+            --cover_count_;
+            erase(cover);
+        }
+    }
+
+    // Under the mutex, before any request over `key` is checked but the owner's ones within a covering lock (an intent
+    // request keeps the covering locks below it).
+    void deescalate_overlapping(lock_tree::key_type key, bool keep_below = false){
+        if (cover_count_ == 0){
+            return;
+        }
+
+        node_handle cover;
+        do{
+            cover = nullptr;
+            inter_tree.for_each_overlap_if(key, true, [&](node_handle it){
+                if (it->value.is_cover && !(keep_below && is_below(it->key, key))){
+                    cover = it;
+                    return false;
+                }
+                return true;
+            });
+
+            if (cover != nullptr){
+                deescalate(cover);
+            }
+        } while (cover != nullptr);
+    }
+
+    // Under the mutex, before an upgrade or a downgrade of a lock on `it`.
+    void deescalate_node(node_handle it){
+        if (it->value.is_escalated){
+            deescalate(find_cover(it->key));
+        }
+    }
+
+    // The escalated locks go back into the tree in place of the covering lock (one of them may have its bounds).
+    void deescalate(node_handle cover){
+        escalation_scratch_.clear();
+        escalated.for_each_overlap(cover->key, [&](node_handle it){
+            escalation_scratch_.push_back(it);
+        });
+
+        --cover_count_;
+        erase(cover);
+
+        for (node_handle it : escalation_scratch_){
+            escalated.extract(it);
+            it->value.is_escalated = false;
+            [[maybe_unused]] bool inserted = inter_tree.insert(it);
+            assert(inserted);
+        }
+    }
+
+    // Whether a hot interval or a dedicated lock keeps `it` in the tree
+    bool is_bound(node_handle it) const{
+        const HotTables* tables = hot_.load(std::memory_order_relaxed);
+        return tables != nullptr && (tables->hot[hot_index(it->key)].node.load(std::memory_order_relaxed) == it
+                                     || tables->dedicated[hot_index(it->key)].node.load(std::memory_order_relaxed) == it);
+    }
+
+    // Under the mutex, after lock_shared() inserted `it` on new bounds: merges it with the shared locks and segments touching it.
+    void coalesce(node_handle it){
+        if (it->value.counter != 1 || is_bound(it)){
+            return;
+        }
+
+        auto near = [](lock_tree::key_type key) -> lock_tree::key_type{
+            return {key.first - (key.first > 0), key.second + (key.second < std::numeric_limits<size_type>::max())};
+        };
+
+        // A lock somebody waits for stays in the tree, it might be an upgrade waiting for its own node to be the last one
+        coalesce_scratch_.clear();
+        lock_tree::key_type segment = it->key;
+        inter_tree.for_each_overlap(near(it->key), [&](node_handle other){
+            if (other != it && !other->value.is_exclusive && !is_bound(other) && waiters.get_overlap(other->key) == waiters.end()){
+                coalesce_scratch_.push_back(other);
+                segment = {std::min(segment.first, other->key.first), std::max(segment.second, other->key.second)};
+            }
+        });
+
+        // The first segment merged takes the new bounds
+        node_handle merged = nullptr;
+        while (node_handle other = segments.get_overlap(near(segment))){
+            segment = {std::min(segment.first, other->key.first), std::max(segment.second, other->key.second)};
+            segments.extract(other);
+            if (merged == nullptr){
+                merged = other;
+            }
+            else{
+                segments.dispose(other);
+            }
+        }
+
+        if (merged == nullptr && coalesce_scratch_.empty()){
+            return;
+        }
+
+        coalesce_scratch_.push_back(it);
+        for (node_handle lock : coalesce_scratch_){
+            inter_tree.extract(lock);
+            lock->value.is_coalesced = true;
+            [[maybe_unused]] bool inserted = coalesced.insert(lock);
+            assert(inserted);
+        }
+
+        if (merged == nullptr){
+            segments.emplace(segment, LockInfo{1, false});
+            return;
+        }
+        merged->key = segment;
+        segments.insert(merged);
+    }
+
+    // Under the mutex, before the coalesced lock `it` leaves the side tree: shrinks or splits its segment.
+    void split_segment(node_handle it){
+        node_handle segment = segments.get_overlap(it->key);
+        lock_tree::key_type key = segment->key;
+        segments.extract(segment);
+
+        covered_scratch_.clear();
+        coalesced.for_each_overlap(it->key, [&](node_handle other){
+            covered_scratch_.push_back({std::max(other->key.first, it->key.first), std::min(other->key.second, it->key.second)});
+        }, true);
+        std::sort(covered_scratch_.begin(), covered_scratch_.end());
+
+        // The first part keeps the node of the segment
+        auto part = [&](lock_tree::key_type bounds){
+            if (segment == nullptr){
+                segments.emplace(bounds, LockInfo{1, false});
+                return;
+            }
+            segment->key = bounds;
+            segments.insert(std::exchange(segment, nullptr));
+        };
+
+        // Sweep `it` from left to right, a part ends at each hole
+        size_type first = key.first;
+        size_type position = it->key.first;
+        auto hole = [&](size_type end){
+            if (first < position){
+                part({first, position});
+            }
+            first = end;
+        };
+
+        for (auto covered : covered_scratch_){
+            if (position < covered.first){
+                hole(covered.first);
+            }
+            position = std::max(position, covered.second);
+        }
+        if (position < it->key.second){
+            hole(it->key.second);
+        }
+        if (first < key.second){
+            part({first, key.second});
+        }
+        if (segment != nullptr){
+            segments.dispose(segment);
+        }
+    }
+
+    // Under the mutex, before an upgrade of a lock on `it`.
+    void uncoalesce_node(node_handle it){
+        if (!it->value.is_coalesced){
+            return;
+        }
+
+        split_segment(it);
+        coalesced.extract(it);
+        it->value.is_coalesced = false;
+        [[maybe_unused]] bool inserted = inter_tree.insert(it);
+        assert(inserted);
+    }
+
+    // The stripes of the keys in `key`, each one once
+    template<class Function>
+    static void for_each_stripe(lock_tree::key_type key, Function function){
+        size_type first = key.first >> version_stripe_shift;
+        size_type last = (key.second - 1) >> version_stripe_shift;
+
+        if (last - first >= version_stripe_count - 1){
+            for (size_type i = 0; i < version_stripe_count; ++i){
+                function(i);
+            }
+            return;
+        }
+
+        for (size_type i = first; i <= last; ++i){
+            function(i % version_stripe_count);
+        }
+    }
+
+    // Counts the exclusive locks held right now, then the ones to come are counted by bump_versions()
+    const VersionStripe* enable_versions(){
+        std::unique_lock<mutex_type> lock(mtx);
+
+        if (VersionStripe* stripes = stripes_.load(std::memory_order_relaxed)){
+            return stripes;
+        }
+
+        // The writers of the dedicated locks do not count themselves before the stripes exist, the tree has them
+        // (and the escalated ones are counted in the tree as well)
+        demote_overlapping({0, std::numeric_limits<size_type>::max()});
+        deescalate_overlapping({0, std::numeric_limits<size_type>::max()});
+
+        stripe_storage_ = std::make_unique<VersionStripe[]>(version_stripe_count);
+        if (!inter_tree.empty()){
+            inter_tree.for_each_overlap({0, std::numeric_limits<size_type>::max()}, [&](node_handle it){
+                if (it->value.is_exclusive){
+                    for_each_stripe(it->key, [&](size_type i){
+                        stripe_storage_[i].word.fetch_add(writer_acquired, std::memory_order_relaxed);
+                    });
+                }
+            });
+        }
+
+        stripes_.store(stripe_storage_.get(), std::memory_order_release);
+        return stripe_storage_.get();
     }
 
-    explicit shared_lock(locker* ptr_main_locker, interval interval) {
-        p_MainLocker = ptr_main_locker;
-        interval_ = std::move(interval);
+    // Under the mutex, whenever an exclusive lock over `key` appears (acquired) or goes.
+    void bump_versions(lock_tree::key_type key, bool acquired){
+        if (VersionStripe* stripes = stripes_.load(std::memory_order_relaxed)){
+            bump_stripes(stripes, key, acquired);
+        }
     }
 
-    shared_lock(const shared_lock&) = delete; // no support for copy
-    shared_lock& operator=(const shared_lock&) = delete; // no support for copy
+    // Also by the writers of the dedicated locks, without the mutex
+    static void bump_stripes(VersionStripe* stripes, lock_tree::key_type key, bool acquired){
+        if (!acquired){
+            // The writes under the lock come before
+            for_each_stripe(key, [&](size_type i){
+                stripes[i].word.fetch_add(writer_released, std::memory_order_release);
+            });
+            return;
+        }
 
-    shared_lock(shared_lock&&) noexcept; // move, invalidate source object
-    shared_lock& operator=(shared_lock&&) noexcept; // unlock `*this` (if not invalid), move, invalidate source object
+        for_each_stripe(key, [&](size_type i){
+            stripes[i].word.fetch_add(writer_acquired, std::memory_order_relaxed);
+        });
 
-    ~shared_lock(); // unlock (if not invalid), noexcept by default
+        // ... and the writes under the lock come after
+        std::atomic_thread_fence(std::memory_order_release);
+    }
 
-    void unlock() noexcept;  // unlock (if not invalid), invalidate
-    exclusive_lock upgrade();   // BLOCKING, upgrade to exclusive_lock, invalidate `*this`
+    // No condition besides the locker's own ones, so the releasing thread can grant the lock on the waiter's behalf
+    struct unguarded_t{
+        bool operator()() const{
+            return true;
+        }
+    };
+    static constexpr unguarded_t unguarded{};
 
-private:
-    locker* p_MainLocker;
-    interval interval_;
+    template<class Park>
+    shared_lock acquire_shared(size_type b, size_type e, Park park){
 
-};
+        if (auto it = try_lock_biased({b, e})){
+            return shared_lock(this, it);
+        }
 
-class exclusive_lock {
-public:
+        bool fallback;
+        if (auto it = try_lock_dedicated({b, e}, false, park, fallback); !fallback){
+            return it != nullptr ? shared_lock(this, it) : shared_lock();
+        }
 
-    using interval = std::pair<std::size_t , std::size_t>;
+        std::unique_lock<mutex_type> lock(mtx);
 
+        if (auto it = try_lock_escalated({b, e}, false)){
+            return shared_lock(this, it);
+        }
 
-    exclusive_lock() noexcept {
-        p_MainLocker = nullptr;
-        interval_={0,0};
+        auto it = acquire_locked(lock, {b, e}, false, park, unguarded);
+        if (it != nullptr && lock.owns_lock() && !it->value.is_coalesced){
+            count_access(it, {b, e}, false);
+            coalesce(it);
+        }
+        return it != nullptr ? shared_lock(this, it) : shared_lock();
     }
 
-    explicit exclusive_lock(locker* ptr_main_locker, interval interval){
-        p_MainLocker = ptr_main_locker;
-        interval_ = std::move(interval);
+    template<class Park>
+    exclusive_lock acquire_exclusive(size_type b, size_type e, Park park){
+
+        bool fallback;
+        if (auto it = try_lock_dedicated({b, e}, true, park, fallback); !fallback){
+            return it != nullptr ? exclusive_lock(this, it) : exclusive_lock();
+        }
+
+        std::unique_lock<mutex_type> lock(mtx);
+
+        if (auto it = try_lock_escalated({b, e}, true)){
+            return exclusive_lock(this, it);
+        }
+
+        auto it = acquire_locked(lock, {b, e}, true, park, unguarded);
+        if (it != nullptr && lock.owns_lock()){
+            count_access(it, {b, e}, true);
+            count_escalation(it, {b, e});
+        }
+        return it != nullptr ? exclusive_lock(this, it) : exclusive_lock();
     }
 
-    exclusive_lock(const exclusive_lock&) = delete; // no support for copy
-    exclusive_lock& operator=(const exclusive_lock&) = delete; // no support for copy
+    template<class Park>
+    intent_lock acquire_intent(size_type b, size_type e, lock_mode mode, Park park){
+        assert(mode != lock_mode::shared && mode != lock_mode::exclusive);
 
-    exclusive_lock(exclusive_lock&&) noexcept; // move, invalidate source object
-    exclusive_lock& operator=(exclusive_lock&&) noexcept; // unlock `*this` (if not invalid), move, invalidate source object
+        std::unique_lock<mutex_type> lock(mtx);
 
-    ~exclusive_lock(); // unlock (if not invalid), noexcept by default
-    void unlock() noexcept;
+        // Registered as an exclusive waiter if it holds back shared requests
+        lock_tree::key_type key{b, e};
+        bool is_exclusive = conflicts_with_shared(mode);
+        auto ticket = next_ticket++;
+        make_way_for_intent(key, mode);
+        if (!wait(lock, key, is_exclusive, ticket, park, [&]{ return can_acquire_intent(key, mode) && !yields_to_waiters(key, is_exclusive, ticket); })){
+            resume_granted(lock);
+            return intent_lock();
+        }
 
-    shared_lock downgrade() noexcept;   // downgrade to shared_lock, invalidate `*this`
+        auto it = insert_intent(key, mode);
+        grant_held_back(lock);
+        return intent_lock(this, it, mode);
+    }
 
-private:
-    locker* p_MainLocker;
-    interval interval_;
+    // Returns nullptr if `park` gave up. `guard` is one more condition of the grant
+    // (a sharded locker makes sure the interval still belongs to this partition).
+    // Without a guard, `lock` might be released on return: a waiter can be handed its lock by the releasing thread, or
+    // wake up the waiters it held back. With a guard, `lock` is held on return.
+    template<class Park, class Guard>
+    node_handle acquire_locked(std::unique_lock<mutex_type>& lock, lock_tree::key_type key, bool is_exclusive, Park park, Guard guard){
+
+        // Wait until we can acquire the lock (and the fairness policy lets us)
+        auto ticket = next_ticket++;
+        make_way(key, is_exclusive);
+        node_handle handed = nullptr;
+        if (!wait(lock, key, is_exclusive, ticket, park, [&]{ return guard() && admissible(key, is_exclusive, ticket); },
+                  std::is_same_v<Guard, unguarded_t> && strategy_ == wait_strategy::handoff ? &handed : nullptr)){
+            resume_granted(lock);
+            return nullptr;
+        }
 
-};
+        if (handed != nullptr){
+            return handed;
+        }
 
-class locker {
-public:
+        auto it = is_exclusive ? insert_exclusive(key) : insert_shared(key);
+        grant_held_back(lock);
+        if constexpr (!std::is_same_v<Guard, unguarded_t>){
+            if (!lock.owns_lock()){
+                lock.lock();
+            }
+        }
+        return it;
+    }
 
+    template<class Park>
+    lock_set acquire_many(std::span<const range_request> requests, Park park){
+
+        // Check (and later insert) the ranges from left to right
+        std::vector<range_request> sorted(requests.begin(), requests.end());
+        std::sort(sorted.begin(), sorted.end(), [](const range_request& a, const range_request& b){ return a.begin < b.begin; });
+
+        size_type end = 0;
+        size_type exclusive_end = 0;
+        for (const auto& request : sorted){
+            assert(request.begin < request.end);
+            assert(request.begin >= exclusive_end && (!request.is_exclusive || request.begin >= end));
+            end = std::max(end, request.end);
+            if (request.is_exclusive){
+                exclusive_end = std::max(exclusive_end, request.end);
+            }
+        }
 
-    // Allow class exclusive_lock and class shared_lock to access the private members/methods of this class.
-    friend class exclusive_lock;
-    friend class shared_lock;
+        std::unique_lock<mutex_type> lock(mtx);
+        auto ticket = next_ticket++;
 
-    using size_type = std::size_t;
+        // Wait for the first range that cannot be granted, then check all of them again (the ranges it did not wait for
+        // may have been promoted or escalated meanwhile)
+        while (true){
+            for (const auto& request : sorted){
+                make_way({request.begin, request.end}, request.is_exclusive);
+            }
 
-    // Interval node that will be added to the interval tree
-    struct LockInfo{
+            auto blocked = std::find_if(sorted.begin(), sorted.end(), [&](const range_request& request){
+                return !admissible({request.begin, request.end}, request.is_exclusive, ticket);
+            });
 
-        // Counter to keep track of the reference count of an interval
-        std::size_t counter;
+            if (blocked == sorted.end()){
+                break;
+            }
 
-        // is_exclusive used to determine if a lock is exclusive or shared
-        bool is_exclusive;
-    };
+            lock_tree::key_type key{blocked->begin, blocked->end};
+            if (!wait(lock, key, blocked->is_exclusive, ticket, park, [&]{ return admissible(key, blocked->is_exclusive, ticket); })){
+                resume_granted(lock);
+                return lock_set();
+            }
 
-    locker() = default;
+            // Nothing is inserted yet, the waiters held back by the request are granted before it waits again
+            grant_candidates();
+            if (granted_head != nullptr){
+                resume_granted(lock);
+                lock.lock();
+            }
+        }
 
-    locker(const locker&) = delete;
-    locker(locker&&) = delete;
-    locker& operator=(const locker&) = delete;
-    locker& operator=(locker&&) = delete;
+        std::vector<node_handle> nodes;
+        nodes.reserve(sorted.size());
+        for (const auto& request : sorted){
+            nodes.push_back(request.is_exclusive ? insert_exclusive({request.begin, request.end}) : insert_shared({request.begin, request.end}));
+        }
+        grant_held_back(lock);
 
-    ~locker(){
+        return lock_set(this, std::move(nodes));
+    }
 
-        // Wait until the tree is empty.
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [this] { return inter_tree.empty(); });
+    // Under the mutex, once per request over `key` before it is checked: the dedicated and covering locks overlapping
+    // it (and the hot intervals, for an exclusive one) go. None of them appears over a waiting request, so they do not
+    // have to go again whenever it is checked while it waits.
+    void make_way(lock_tree::key_type key, bool is_exclusive){
+        demote_overlapping(key);
+        deescalate_overlapping(key);
+        if (is_exclusive){
+            revoke_overlapping(key);
+        }
     }
 
-    shared_lock lock_shared(size_type b, size_type e) {
+    // Whether a request can be granted right now, the fairness policy included (make_way() came first).
+    bool admissible(lock_tree::key_type key, bool is_exclusive, std::uint64_t ticket){
+        if (is_exclusive){
+            return can_acquire_exclusive_lock(key.first, key.second) && !yields_to_waiters(key, true, ticket);
+        }
+        return can_acquire_shared_lock(key.first, key.second) && !yields_to_waiters(key, false, ticket);
+    }
+
+    node_handle insert_shared(lock_tree::key_type key){
+
+        // A coalesced lock on these bounds counts one more reader
+        if (!segments.empty()){
+            if (node_handle it = coalesced.find(key)){
+                it->value.counter++;
+                return it;
+            }
+        }
 
-        std::unique_lock<std::mutex> lock(mtx);
-        // Wait until we can acquire a shared lock
-        cv.wait(lock, [&] { return can_acquire_shared_lock(b, e); });
-        auto it = inter_tree.find({b, e});
+        // If the interval is not in the tree, then create a new interval node and add it to the tree.
+        LockInfo new_shared_lock{1, false};
+        auto [it, inserted] = inter_tree.emplace(key, new_shared_lock);
 
         // If the interval is already in the tree, then increment the reference counter since we can have multiple shared locks over an interval
-        if (it != inter_tree.end()){
+        if (!inserted){
             it->value.counter++;
         }
-        else{
 
-            // If it is not in the tree, then create a new interval node and add it to the tree.
-            LockInfo new_shared_lock{1, false};
-            inter_tree.emplace({b, e}, new_shared_lock);
-        }
+        return it;
+    }
 
-        return shared_lock(this , {b, e});
+    static bool conflicts_with_shared(lock_mode mode){
+        return !lock_modes_compatible(mode, lock_mode::shared);
     }
 
-    exclusive_lock lock_exclusive(size_type b, size_type e){
+    intent_lock_tree::node* insert_intent(lock_tree::key_type key, lock_mode mode){
+        auto it = intents.emplace(key, IntentInfo{{}, false}).first;
+        it->value.holders[static_cast<int>(mode)]++;
+
+        if (conflicts_with_shared(mode) && !it->value.is_exclusive){
+            it->value.is_exclusive = true;
+            intents.refresh(it);
+        }
+        return it;
+    }
+
+    // Drop one holder in `mode`, and the node with the last one.
+    void erase_intent(intent_lock_tree::node* it, lock_mode mode){
+        auto& holders = it->value.holders;
+        holders[static_cast<int>(mode)]--;
 
-        std::unique_lock<std::mutex> lock(mtx);
+        if (std::all_of(std::begin(holders), std::end(holders), [](std::size_t count){ return count == 0; })){
+            intents.erase(it);
+            if (idle()){
+                cv.notify_all();
+            }
+        }
+        else if (it->value.is_exclusive && holders[static_cast<int>(lock_mode::intent_exclusive)] == 0
+                 && holders[static_cast<int>(lock_mode::shared_intent_exclusive)] == 0){
+            it->value.is_exclusive = false;
+            intents.refresh(it);
+        }
+    }
 
-        // Wait until we can acquire an exclusive lock
-        cv.wait(lock, [&]{ return can_acquire_exclusive_lock(b, e);});
+    node_handle insert_exclusive(lock_tree::key_type key){
 
         // Similarly, we create an interval node, and we add it to the tree.
         LockInfo new_exclusive_lock{1, true};
 
         // We add it again since at every unlock the corresponding interval is erased from the tree.
-        inter_tree.emplace({b, e}, new_exclusive_lock);
+        bump_versions(key, true);
+        return inter_tree.emplace(key, new_exclusive_lock).first;
+    }
+
+    // Block (with `lock` held) until `pred` holds, registered as a waiter for `key` in the meantime.
+    // Returns false if `park` gave up first.
+    // With `handed`, `pred` has to be admissible() for `key`: the releasing thread may grant the request right away, then
+    // the node is stored into `handed` and `lock` might be released.
+    template<class Park, class Predicate>
+    bool wait(std::unique_lock<mutex_type>& lock, lock_tree::key_type key, bool is_exclusive, std::uint64_t ticket, Park park, Predicate pred,
+              node_handle* handed = nullptr){
+
+        if (pred()){
+            return true;
+        }
+
+        if constexpr (std::is_same_v<Park, dont_park>){
+            return false;
+        }
+
+        // Whoever queued up candidates granted them before releasing the mutex
+        assert(candidates == nullptr);
+
+        Waiter self;
+        self.ticket = ticket;
+        self.is_exclusive = is_exclusive;
+        if (handed != nullptr){
+            self.resume = &unpark;
+        }
+        link_waiter(self, key);
+
+        // Only a waiter that waits as long as it takes spins
+        constexpr bool may_spin = std::is_same_v<Park, park_forever>;
+        std::chrono::steady_clock::time_point start;
+        if (may_spin && strategy_ == wait_strategy::spin_then_park){
+            start = std::chrono::steady_clock::now();
+        }
+
+        auto record_wait = [&]{
+            if (may_spin && strategy_ == wait_strategy::spin_then_park){
+                auto average = average_wait_.load(std::memory_order_relaxed);
+                average_wait_.store(average + (std::chrono::steady_clock::now() - start - average) / 8, std::memory_order_relaxed);
+            }
+        };
+
+        bool granted;
+        do{
+            // Reset under the mutex, and never after a grant (unpark() might be storing into it right now)
+            self.signal.store(Waiter::idle, std::memory_order_relaxed);
 
-        return exclusive_lock(this , {b, e});
+            // One more check after giving up, the predicate might have become true in the meantime
+            bool parked = (may_spin && spin(self, lock)) || park(self, lock);
+
+            // The releaser unlinked us
+            if (handed_over(self, lock)){
+                *handed = self.granted;
+                record_wait();
+                return true;
+            }
+
+            granted = pred();
+
+            if (!parked){
+                break;
+            }
+        } while (!granted);
+
+        unlink_waiter(self);
+        record_wait();
+
+        // The fairness policy might have held back others because of us. Once granted, they are only queued up here: the
+        // caller grants them (grant_held_back()) after its lock is in the tree.
+        if constexpr (!std::is_same_v<FairnessPolicy, reader_preferring>){
+            if (!granted){
+                wake_overlapping(key);
+            }
+            else{
+                notify_overlapping(key);
+            }
+        }
+
+        return granted;
     }
 
-private:
+    void link_waiter(Waiter& self, lock_tree::key_type key){
+        auto it = waiters.emplace(key, WaiterList{nullptr, nullptr, 0, false}).first;
 
-    std::mutex mtx;
-    std::condition_variable cv;
-    interval_tree<LockInfo> inter_tree;
+        if (self.is_exclusive && it->value.exclusive_count++ == 0){
+            it->value.is_exclusive = true;
+            waiters.refresh(it);
+        }
 
-    bool can_acquire_shared_lock(size_type b, size_type e, bool ignore_self=false){
-        
-        // Neither of the overlaps is exclusive == true
-        auto overlapping_nodes = inter_tree.get_overlaps({b, e}, ignore_self);
-        for (const auto &node : overlapping_nodes){
-            if (node->value.is_exclusive){
-                return false;
+        self.key = key;
+        self.node = it;
+        self.prev = it->value.tail;
+        if (self.prev != nullptr){
+            self.prev->next = &self;
+        }
+        else{
+            it->value.head = &self;
+        }
+        it->value.tail = &self;
+    }
+
+    void unlink_waiter(Waiter& self){
+
+        // The node of our interval cannot disappear while we are in its list
+        auto it = self.node;
+        (self.prev != nullptr ? self.prev->next : it->value.head) = self.next;
+        (self.next != nullptr ? self.next->prev : it->value.tail) = self.prev;
+
+        if (it->value.head == nullptr){
+            waiters.erase(it);
+        }
+        else if (self.is_exclusive && --it->value.exclusive_count == 0){
+            it->value.is_exclusive = false;
+            waiters.refresh(it);
+        }
+    }
+
+    // Whether the fairness policy holds back a request because of the overlapping waiting requests.
+    bool yields_to_waiters(lock_tree::key_type key, bool is_exclusive, std::uint64_t ticket){
+
+        if constexpr (std::is_same_v<FairnessPolicy, writer_preferring>){
+            return !is_exclusive && waiters.get_overlap_if(key, true) != waiters.end();
+        }
+        else if constexpr (std::is_same_v<FairnessPolicy, fifo_per_overlap>){
+            return !waiters.for_each_overlap(key, [&](waiter_tree::node* it){
+                for (Waiter* waiter = it->value.head; waiter != nullptr; waiter = waiter->next){
+                    if (waiter->ticket < ticket && (is_exclusive || waiter->is_exclusive)){
+                        return false;
+                    }
+                }
+                return true;
+            });
+        }
+        else{
+            static_assert(std::is_same_v<FairnessPolicy, reader_preferring>, "unknown fairness policy");
+            return false;
+        }
+    }
+
+    // wait_strategy::spin_then_park: spin with the mutex released until notified, for about twice the average wait.
+    // True if notified, false if the waiter has to park (also right away, with an average beyond max_spin).
+    bool spin(Waiter& self, std::unique_lock<mutex_type>& lock){
+
+        static const bool single_cpu = std::thread::hardware_concurrency() <= 1;
+        auto average = average_wait_.load(std::memory_order_relaxed);
+        if (strategy_ != wait_strategy::spin_then_park || single_cpu || average > max_spin){
+            return false;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::max(2 * average, std::chrono::nanoseconds{1'000});
+        lock.unlock();
+
+        // Exponential backoff between the checks
+        for (unsigned backoff = 1; self.signal.load(std::memory_order_acquire) == Waiter::idle; backoff = std::min(2 * backoff, 64u)){
+            for (unsigned i = 0; i < backoff; ++i){
+                cpu_relax();
+            }
+
+            if (std::chrono::steady_clock::now() >= deadline){
+                break;
             }
         }
+
+        // Handed the lock while spinning, no need for the mutex
+        if (self.signal.load(std::memory_order_acquire) >= Waiter::granting){
+            return true;
+        }
+
+        // A notification or a grant comes under the mutex, so one that missed the spinning is seen here (and not lost by parking)
+        lock.lock();
+        return self.signal.load(std::memory_order_relaxed) != Waiter::idle || self.granted != nullptr;
+    }
+
+    // Whether the releasing thread handed `self` its lock. With the mutex the grant itself tells, without it the
+    // signal (the waiter only gives the mutex up for good after seeing it).
+    static bool handed_over(Waiter& self, std::unique_lock<mutex_type>& lock){
+        if (lock.owns_lock() ? self.granted == nullptr : self.signal.load(std::memory_order_acquire) < Waiter::granting){
+            return false;
+        }
+
+        // unpark() still touches the record until its last store
+        while (self.signal.load(std::memory_order_acquire) != Waiter::handed_over){
+            std::this_thread::yield();
+        }
         return true;
     }
 
-    // Not a single overlap == true
-    bool can_acquire_exclusive_lock(size_type b, size_type e){
-        return inter_tree.get_overlap({b, e}) == inter_tree.end();
+    // The `resume` of a thread handed its lock, wherever it sleeps. handed_over is the last store into the record,
+    // the waiter may return as soon as it sees it.
+    static void unpark(Waiter& self){
+        self.signal.store(Waiter::granting, std::memory_order_release);
+        self.signal.notify_one();
+        self.cv.notify_one();
+        self.signal.store(Waiter::handed_over, std::memory_order_release);
+    }
+
+    static void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // Wake up the waiters whose interval overlaps `key`, they re-check their predicates.
+    // The suspended coroutines and the plain thread waiters are granted their locks right here instead (if they can
+    // have them), the caller has to resume_granted() before it returns.
+    void wake_overlapping(lock_tree::key_type key){
+        notify_overlapping(key);
+        grant_candidates();
     }
 
+    // The first half of wake_overlapping(), called for every released interval of a batch.
+    // A waiter overlapping several of them is notified once.
+    void notify_overlapping(lock_tree::key_type key){
+        waiters.for_each_overlap(key, [&](waiter_tree::node* it){
+            for (Waiter* waiter = it->value.head; waiter != nullptr; waiter = waiter->next){
+                if (waiter->woken == wake_pass){
+                    continue;
+                }
+
+                waiter->woken = wake_pass;
+                if (waiter->resume == nullptr){
+                    waiter->signal.store(Waiter::notified, std::memory_order_release);
+                    waiter->signal.notify_one();
+                    waiter->cv.notify_one();
+                }
+                else{
+                    *candidates_tail = waiter;
+                    candidates_tail = &waiter->next_granted;
+                }
+            }
+        });
+    }
 
-    void unlock_shared(size_type b, size_type e){
+    // The second half, once the intervals are released.
+    // Granting modifies the trees, so it cannot happen during the traversal (and one grant can rule out the next one).
+    // A granted waiter queues up the waiters overlapping it again, the fairness policy might have held them back because of it.
+    void grant_candidates(){
+        *candidates_tail = nullptr;
+
+        while (candidates != nullptr){
+            Waiter* waiter = candidates;
+            candidates = waiter->next_granted;
+            if (candidates == nullptr){
+                candidates_tail = &candidates;
+            }
 
-        std::unique_lock<std::mutex> lock(mtx);
+            // Out of the queue, so it can be queued up again
+            waiter->woken = 0;
 
-        // Find the interval in the interval tree, if it is there, decrease the counter
-        // if it is there and the counter became 0, then this is the last shared_lock. Therefore, we can erase the interval
-        // Then we let our condition variable wake up all the threads to check whose predicate is satisfied in order to take over this interval (if there are any).
-        auto it = inter_tree.find({b, e});
+            if (admissible(waiter->key, waiter->is_exclusive, waiter->ticket)){
+                waiter->granted = waiter->is_exclusive ? insert_exclusive(waiter->key) : insert_shared(waiter->key);
+                unlink_waiter(*waiter);
 
-        if (it != inter_tree.end()){
-            it->value.counter--;
+                waiter->next_granted = granted_head;
+                granted_head = waiter;
 
-            if (it->value.counter == 0){
-                inter_tree.erase({b,e});
+                if constexpr (!std::is_same_v<FairnessPolicy, reader_preferring>){
+                    notify_overlapping(waiter->key);
+                    *candidates_tail = nullptr;
+                }
             }
         }
 
-        cv.notify_all();
+        wake_pass++;
     }
 
-    void unlock_exclusive(size_type b, size_type e){
-        // Nothing to do with counters since 1 exclusive lock over 1 particular interval
-        // Just erase it from the tree and notify_all()
-        std::unique_lock<std::mutex> lock(mtx);
-        inter_tree.erase({b,e});
-        cv.notify_all();
+    // After a request that waited put its lock into the tree: grant the waiters wait() queued up behind it, and wake
+    // them up (which releases `lock`). Also ends the wakeup pass of the ones it notified, even if none was queued up:
+    // a notified waiter which parks again must not be skipped by the next pass.
+    void grant_held_back(std::unique_lock<mutex_type>& lock){
+        grant_candidates();
+        resume_granted(lock);
     }
 
+    // Hand the coroutines granted by wake_overlapping() over to their executors and wake up the granted threads,
+    // outside of the critical section.
+    void resume_granted(std::unique_lock<mutex_type>& lock){
+        if (granted_head == nullptr){
+            return;
+        }
 
+        Waiter* waiter = std::exchange(granted_head, nullptr);
+        lock.unlock();
 
-    // Downgrade from exclusive to locked.
-    shared_lock actual_downgrade(size_type b, size_type e){
+        // A resumed coroutine (or a woken thread) may destroy its waiter record
+        while (waiter != nullptr){
+            Waiter* next = waiter->next_granted;
+            waiter->resume(*waiter);
+            waiter = next;
+        }
+    }
+
+    void erase(node_handle it){
+        if (it->value.is_coalesced){
+            split_segment(it);
+            coalesced.extract(it);
+            inter_tree.dispose(it);
+        }
+        else{
+            if (it->value.is_exclusive){
+                bump_versions(it->key, false);
+                if (it->value.owner != 0){
+                    uncount_escalation(it);
+                }
+            }
+            inter_tree.erase(it);
+        }
 
-        std::unique_lock<std::mutex> lock(mtx);
+        if (idle()){
+            cv.notify_all();
+        }
+    }
 
-        // Wait until we can acquire a shared lock by making sure no exclusive lock is over that interval
-        cv.wait(lock, [&] { return can_acquire_shared_lock(b, e, true); });
+    // No lock is held (the escalated ones are behind a covering lock in inter_tree)
+    bool idle() const{
+        return inter_tree.empty() && intents.empty() && coalesced.empty();
+    }
 
-        // change the is_exclusive to false;
-        // counter remains 1
-        auto it = inter_tree.find({b, e});
-        // it can not be it.end() since we are downgrading,
-        it->value.is_exclusive = false;
+    bool can_acquire_shared_lock(size_type b, size_type e, bool ignore_self=false){
+        
+        // Neither of the overlaps is exclusive == true (nor an intent lock conflicting with it)
+        // The tree keeps the maximum end of exclusive intervals per subtree, so this does not depend on the number of overlapping shared locks.
+        return inter_tree.get_overlap_if({b, e}, true, ignore_self) == inter_tree.end()
+               && compatible_with_intents({b, e}, lock_mode::shared);
+    }
 
-        // Return
-        return shared_lock(this, {b, e});
+    // Not a single overlap == true (but the intent locks it is below), a segment overlaps a coalesced lock
+    bool can_acquire_exclusive_lock(size_type b, size_type e){
+        return inter_tree.get_overlap({b, e}) == inter_tree.end() && segments.get_overlap({b, e}) == segments.end()
+               && compatible_with_intents({b, e}, lock_mode::exclusive);
     }
 
+    // make_way() of an intent or update request
+    void make_way_for_intent(lock_tree::key_type key, lock_mode mode){
+        if (!is_intent(mode)){
+            make_way(key, false);
+            return;
+        }
+
+        // The hot, dedicated and covering intervals below the request do not conflict with it
+        demote_overlapping(key, true);
+        deescalate_overlapping(key, true);
+        if (conflicts_with_shared(mode)){
+            revoke_overlapping(key, true);
+        }
+    }
 
-    exclusive_lock actual_upgrade(size_type b, size_type e){
+    bool can_acquire_intent(lock_tree::key_type key, lock_mode mode){
+        if (!is_intent(mode)){
+            // An update lock, it conflicts with the exclusive locks only
+            return inter_tree.get_overlap_if(key, true) == inter_tree.end() && compatible_with_intents(key, mode);
+        }
+        return compatible_with_locks(key, mode) && compatible_with_intents(key, mode);
+    }
 
-        std::unique_lock<std::mutex> lock(mtx);
+    // Intent locks are a level above the shared, exclusive and update locks within their ranges: those never conflict
+    // with them (their holders take intent locks of their own over the range, at the upper level).
+    static bool is_intent(lock_mode mode){
+        return mode == lock_mode::intent_shared || mode == lock_mode::intent_exclusive || mode == lock_mode::shared_intent_exclusive;
+    }
 
-        //
-        cv.wait(lock, [&]{
+    static bool is_below(lock_tree::key_type inner, lock_tree::key_type outer){
+        return outer.first <= inner.first && inner.second <= outer.second && inner != outer;
+    }
 
-            // Find the interval in the tree
-            auto it = inter_tree.find({ b, e});
+    // Whether a request in `mode` over `key` conflicts with a lock held in `held` over `held_key` (the two overlap).
+    static bool conflicts(lock_mode mode, lock_tree::key_type key, lock_mode held, lock_tree::key_type held_key){
+        if (lock_modes_compatible(mode, held)){
+            return false;
+        }
 
+        if (is_intent(mode) && !is_intent(held)){
+            return !is_below(held_key, key);
+        }
+        if (!is_intent(mode) && is_intent(held)){
+            return !is_below(key, held_key);
+        }
+        return true;
+    }
 
-            // If counter == 1, and no overlaps occur over this interval (excluding self) then return we can upgrade to exclusive.
-            return it->value.counter == 1
-                   && inter_tree.get_overlap({b, e}, true)
-                      == inter_tree.end();
+    // Whether a request in `mode` over `key` is compatible with the intent and update locks held (but the update lock
+    // held on `self`, which is upgraded). A shared request only looks at the ones conflicting with shared locks.
+    bool compatible_with_intents(lock_tree::key_type key, lock_mode mode, intent_lock_tree::node* self = nullptr){
+        return intents.for_each_overlap_if(key, mode == lock_mode::shared, [&](intent_lock_tree::node* it){
+            for (int held = 0; held < 6; ++held){
+                auto count = it->value.holders[held] - (it == self && held == static_cast<int>(lock_mode::update));
+                if (count != 0 && conflicts(mode, key, static_cast<lock_mode>(held), it->key)){
+                    return false;
+                }
+            }
+            return true;
         });
+    }
 
-        // Tree doesn't preserve references.
-        // So we need to find it again
-        auto it = inter_tree.find({b, e});
+    // Whether a request in an intent `mode` over `key` is compatible with the shared and exclusive locks held. Those that
+    // are not below it overlap one of its ends, so this does not depend on the number of fine grained locks inside.
+    bool compatible_with_locks(lock_tree::key_type key, lock_mode mode){
+        bool exclusive_only = lock_modes_compatible(mode, lock_mode::shared);
+        auto compatible = [&](node_handle it){
+            return !conflicts(mode, key, it->value.is_exclusive ? lock_mode::exclusive : lock_mode::shared, it->key);
+        };
+
+        // (the coalesced locks are checked one by one, a segment may well stick out of the request where they do not)
+        return inter_tree.for_each_overlap_if({key.first, key.first + 1}, exclusive_only, compatible)
+               && inter_tree.for_each_overlap_if({key.second - 1, key.second}, exclusive_only, compatible)
+               && (exclusive_only || (coalesced.for_each_overlap({key.first, key.first + 1}, compatible)
+                                      && coalesced.for_each_overlap({key.second - 1, key.second}, compatible)));
+    }
 
-        // it can not be it.end() since we are upgrading
-        // Set is_exclusive to true since we are upgrading
-        // Counter remains = 1
-        it->value.is_exclusive = true;
 
-        // return
-        return exclusive_lock(this, {b, e});
+    void unlock_shared(node_handle it){
+        if (try_unlock_biased(it) || try_unlock_dedicated(it)){
+            return;
+        }
 
+        std::unique_lock<mutex_type> lock(mtx);
+        unlock_shared(it, lock);
     }
 
-};
+    void unlock_shared(node_handle it, std::unique_lock<mutex_type>& lock){
+        if (it->value.is_escalated){
+            unlock_escalated(it);
+            return;
+        }
+
+        // While the interval is hot, the released lock might be in a slot of another thread
+        revoke_node(it);
+
+        // The handle points straight at the interval node, decrease the counter
+        // if the counter became 0, then this is the last shared_lock. Therefore, we can erase the interval
+        // Then we wake up the threads waiting for an overlapping interval to check whose predicate is satisfied in order to take over this interval (if there are any).
+        // (even if the interval stays, an upgrade of the last remaining shared lock might be waiting)
+        auto key = it->key;
+        it->value.counter--;
+
+        if (it->value.counter == 0){
+            erase(it);
+        }
+
+        wake_overlapping(key);
+        resume_granted(lock);
+    }
+
+    // Release all the intervals in one critical section, with a single wakeup pass.
+    void unlock_many(std::span<const node_handle> nodes){
+
+        std::unique_lock<mutex_type> lock(mtx);
+
+        for (auto it : nodes){
+            notify_overlapping(it->key);
+        }
 
-//// --------
-// EXCLUSIVE LOCK METHODS
+        for (auto it : nodes){
+            if (try_unlock_dedicated(it)){
+                continue;
+            }
 
-//exclusive_lock(exclusive_lock&&) noexcept; // move, invalidate source object
-//exclusive_lock& operator=(exclusive_lock&&) noexcept; // unlock `*this` (if not invalid), move, invalidate source object
-//
-//~exclusive_lock(); // unlock (if not invalid), noexcept by default
-//void unlock() noexcept;
-//
-//shared_lock downgrade() noexcept;   // downgrade to shared_lock, invalidate `*this`
+            if (it->value.is_escalated){
+                unlock_escalated(it);
+                continue;
+            }
 
-exclusive_lock::exclusive_lock(exclusive_lock &&other) noexcept {
-    p_MainLocker = other.p_MainLocker;
-    interval_ = other.interval_;
-    other.p_MainLocker = nullptr;
-    other.interval_ = {0, 0};
-}
+            if (!it->value.is_exclusive){
+                if (try_unlock_biased(it)){
+                    continue;
+                }
+                revoke_node(it);
+            }
 
-exclusive_lock &exclusive_lock::operator=(exclusive_lock &&other) noexcept {
-    if (this != &other) {
-        if (p_MainLocker) {
-            p_MainLocker->unlock_exclusive(interval_.first, interval_.second);
+            if (it->value.is_exclusive || --it->value.counter == 0){
+                erase(it);
+            }
         }
 
-        p_MainLocker = other.p_MainLocker;
-        interval_ = other.interval_;
-        other.p_MainLocker = nullptr;
-        other.interval_ = {0, 0};
+        grant_candidates();
+        resume_granted(lock);
     }
-    return *this;
-}
 
-exclusive_lock::~exclusive_lock() {
+    void unlock_exclusive(node_handle it){
+        if (try_unlock_dedicated(it)){
+            return;
+        }
 
-    if (p_MainLocker != nullptr) {
-        p_MainLocker->unlock_exclusive(interval_.first, interval_.second);
+        std::unique_lock<mutex_type> lock(mtx);
+        unlock_exclusive(it, lock);
     }
-}
 
-void exclusive_lock::unlock() noexcept {
-    if (p_MainLocker != nullptr) {
-        p_MainLocker->unlock_exclusive(interval_.first, interval_.second);
-        p_MainLocker = nullptr;
+    void unlock_exclusive(node_handle it, std::unique_lock<mutex_type>& lock){
+        if (it->value.is_escalated){
+            unlock_escalated(it);
+            return;
+        }
+
+        // Nothing to do with counters since 1 exclusive lock over 1 particular interval
+        // Just erase it from the tree and wake up the overlapping waiters
+        auto key = it->key;
+        erase(it);
+        wake_overlapping(key);
+        resume_granted(lock);
     }
-}
 
-shared_lock exclusive_lock::downgrade() noexcept {
+    void unlock_intent(intent_lock_tree::node* it, lock_mode mode){
+        std::unique_lock<mutex_type> lock(mtx);
 
-    shared_lock result;
-    if (p_MainLocker != nullptr){
-        result = p_MainLocker->actual_downgrade(interval_.first, interval_.second);
+        auto key = it->key;
+        erase_intent(it, mode);
+        wake_overlapping(key);
+        resume_granted(lock);
     }
 
-    p_MainLocker->cv.notify_all();
-    p_MainLocker = nullptr;
 
-    return result;
-}
 
-//// --------
-// SHARED LOCK METHODS
+    // Downgrade from exclusive to locked.
+    shared_lock actual_downgrade(node_handle it){
 
-//shared_lock(shared_lock&&) noexcept; // move, invalidate source object
-//shared_lock& operator=(shared_lock&&) noexcept; // unlock `*this` (if not invalid), move, invalidate source object
-//
-//~shared_lock(); // unlock (if not invalid), noexcept by default
-//
-//void unlock() noexcept;  // unlock (if not invalid), invalidate
-//exclusive_lock upgrade();   // BLOCKING, upgrade to exclusive_lock, invalidate `*this`
+        std::unique_lock<mutex_type> lock(mtx);
+        downgrade_locked(it, lock);
 
-shared_lock::shared_lock(shared_lock &&other ) noexcept {
-    p_MainLocker = other.p_MainLocker;
-    interval_ = other.interval_;
-    other.p_MainLocker = nullptr;
-    other.interval_ = {0, 0};
-}
+        // Return
+        return shared_lock(this, it);
+    }
 
-shared_lock &shared_lock::operator=(shared_lock &&other) noexcept {
-    if (this != &other) {
-        if (p_MainLocker) {
-            p_MainLocker->unlock_shared(interval_.first, interval_.second);
-        }
+    void downgrade_locked(node_handle it, std::unique_lock<mutex_type>& lock){
+
+        // A dedicated writer (or an escalated one) becomes the exclusive lock in the node first
+        demote_node(it);
+        deescalate_node(it);
+
+        // Wait until we can acquire a shared lock by making sure no exclusive lock is over that interval
+        wait(lock, it->key, false, next_ticket++, park_forever{}, [&] { return can_acquire_shared_lock(it->key.first, it->key.second, true); });
+
+        // change the is_exclusive to false;
+        // counter remains 1
+        it->value.is_exclusive = false;
+        it->value.owner = 0;
+        inter_tree.refresh(it);
+        bump_versions(it->key, false);
+
+        // The shared waiters over this interval can now proceed
+        wake_overlapping(it->key);
+        resume_granted(lock);
+    }
+
+
+    exclusive_lock actual_upgrade(node_handle it){
+        return upgrade(it, park_forever{});
+    }
 
-        p_MainLocker = other.p_MainLocker;
-        interval_ = other.interval_;
-        other.p_MainLocker = nullptr;
-        other.interval_ = {0, 0};
+    exclusive_lock actual_upgrade(node_handle it, std::stop_token token){
+        return until_stopped(token, [&](auto park){ return upgrade(it, park); });
     }
-    return *this;
-}
 
-shared_lock::~shared_lock() {
-    if (p_MainLocker != nullptr) {
-        p_MainLocker->unlock_shared(interval_.first, interval_.second);
+    template<class Clock, class Duration>
+    exclusive_lock actual_try_upgrade_until(node_handle it, const std::chrono::time_point<Clock, Duration>& deadline){
+        return upgrade(it, park_until<Clock, Duration>{deadline});
     }
-}
 
-void shared_lock::unlock() noexcept {
+    // Upgrade of an update lock. No other update lock overlaps it, so it only waits for the readers (and the intent locks
+    // it is not below) to go, which never wait for another upgrade.
+    exclusive_lock actual_upgrade(intent_lock_tree::node* it){
+
+        std::unique_lock<mutex_type> lock(mtx);
+
+        auto key = it->key;
+        revoke_overlapping(key);
+        demote_overlapping(key);
+        deescalate_overlapping(key);
+        wait(lock, key, true, next_ticket++, park_forever{}, [&]{
+            return inter_tree.get_overlap(key) == inter_tree.end() && segments.get_overlap(key) == segments.end()
+                   && compatible_with_intents(key, lock_mode::exclusive, it);
+        });
+
+        // The update lock becomes an exclusive one, nobody can have been waiting for the change
+        erase_intent(it, lock_mode::update);
+        auto node = insert_exclusive(key);
+        grant_held_back(lock);
+        return exclusive_lock(this, node);
+    }
+
+    // Returns an empty handle if `park` gave up, the shared lock is kept then.
+    template<class Park>
+    exclusive_lock upgrade(node_handle it, Park park){
+
+        std::unique_lock<mutex_type> lock(mtx);
+
+        if (!upgrade_locked(it, lock, park, unguarded)){
+            return exclusive_lock();
+        }
+
+        // return
+        return exclusive_lock(this, it);
 
-    if (p_MainLocker != nullptr) {
-        p_MainLocker->unlock_shared(interval_.first, interval_.second);
-        p_MainLocker = nullptr;
     }
-}
 
-exclusive_lock shared_lock::upgrade() {
+    // Returns false if `park` gave up (see acquire_locked for `guard`), `lock` might be released on return.
+    template<class Park, class Guard>
+    bool upgrade_locked(node_handle it, std::unique_lock<mutex_type>& lock, Park park, Guard guard){
+
+        // If counter == 1, and no overlaps occur over this interval (excluding self) then return we can upgrade to exclusive.
+        // (an upgrade never yields to the waiters, they might be waiting for this very lock)
+        revoke_overlapping(it->key);
+        demote_node(it);
+        deescalate_node(it);
+        uncoalesce_node(it);
+        bool upgraded = wait(lock, it->key, true, next_ticket++, park, [&]{
+            return guard()
+                   && it->value.counter == 1
+                   && inter_tree.get_overlap(it->key, true)
+                      == inter_tree.end()
+                   && segments.get_overlap(it->key) == segments.end()
+                   && compatible_with_intents(it->key, lock_mode::exclusive);
+        });
+
+        if (!upgraded){
+            resume_granted(lock);
+            return false;
+        }
+
+        // Set is_exclusive to true since we are upgrading
+        // Counter remains = 1
+        bump_versions(it->key, true);
+        it->value.is_exclusive = true;
+        inter_tree.refresh(it);
 
-    exclusive_lock result;
-    if (p_MainLocker != nullptr){
-        result = p_MainLocker->actual_upgrade(interval_.first, interval_.second);
-        p_MainLocker = nullptr;
+        grant_held_back(lock);
+        return true;
     }
 
-    return result;
-}
+public:
+
+    // Returned by async_lock_shared/async_lock_exclusive. While suspended, the coroutine is registered as a waiter
+    // like a blocked thread, the awaiter (living in the coroutine frame) is the waiter record.
+    template<class Lock, class Executor>
+    class lock_awaiter : Waiter{
+    public:
+
+        lock_awaiter(basic_locker* owner, lock_tree::key_type key, Executor executor)
+            : owner_(owner), executor_(std::move(executor)){
+            this->key = key;
+            this->is_exclusive = std::is_same_v<Lock, exclusive_lock>;
+            this->resume = &resume_on_executor;
+        }
+
+        lock_awaiter(const lock_awaiter&) = delete;
+        lock_awaiter& operator=(const lock_awaiter&) = delete;
+
+        bool await_ready() const noexcept{
+            return false;
+        }
+
+        // Either takes the lock right away (and does not suspend) or registers as a waiter, atomically.
+        bool await_suspend(std::coroutine_handle<> handle){
+
+            std::unique_lock<mutex_type> lock(owner_->mtx);
+
+            this->ticket = owner_->next_ticket++;
+            owner_->make_way(this->key, this->is_exclusive);
+            if (owner_->admissible(this->key, this->is_exclusive, this->ticket)){
+                this->granted = this->is_exclusive ? owner_->insert_exclusive(this->key) : owner_->insert_shared(this->key);
+                return false;
+            }
+
+            // May be resumed by another thread as soon as the mutex is released
+            handle_ = handle;
+            owner_->link_waiter(*this, this->key);
+            return true;
+        }
+
+        Lock await_resume(){
+            return Lock(owner_, this->granted);
+        }
+
+    private:
+        basic_locker* owner_;
+        Executor executor_;
+        std::coroutine_handle<> handle_;
+
+        static void resume_on_executor(Waiter& self){
+            auto& awaiter = static_cast<lock_awaiter&>(self);
+            awaiter.executor_(awaiter.handle_);
+        }
+    };
+
+};
 
 #endif //INTERVAL_LOCK_LOCKER_HPP
\ No newline at end of file
@@ -0,0 +1,328 @@
+#ifndef INTERVAL_LOCK_NUMA_LOCKER_HPP
+#define INTERVAL_LOCK_NUMA_LOCKER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "sharded_locker.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Locker engine for machines with several NUMA nodes (sockets).
+//
+// numa_topology reads the nodes and their CPUs from /sys/devices/system/node. cohort_mutex is a cohort lock, a global
+// lock plus a local lock per node: while threads of the same node are waiting, the global lock is passed on among
+// them (at most max_handoffs times in a row), so the data it guards stays in one socket's caches for a while.
+//
+// basic_numa_locker is a sharded locker with shards_per_node consecutive partitions homed on every node. The
+// partitions are guarded by cohort mutexes, and their arenas (the tree node pools) are preallocated by a thread bound
+// to the home node, so the kernel places that memory on the node (first touch).
+//
+// On a single-node machine (or without /sys) a cohort_mutex is a plain mutex, nothing is bound to a node and the key
+// space is a single partition, so the locker behaves like a locker.
+
+class numa_topology{
+public:
+
+    using size_type = std::size_t;
+
+    // The topology of this machine, read once
+    static const numa_topology& system(){
+        static const numa_topology topology("/sys/devices/system/node");
+        return topology;
+    }
+
+    // Reads <root>/node<N>/cpulist. The nodes without CPUs are left out, the others are numbered from 0 in the order of N.
+    explicit numa_topology(const std::filesystem::path& root){
+
+        std::vector<std::pair<size_type, std::vector<unsigned>>> found;
+
+        std::error_code error;
+        for (auto& entry : std::filesystem::directory_iterator(root, error)){
+            std::string name = entry.path().filename().string();
+            if (name.size() <= 4 || name.compare(0, 4, "node") != 0 || !std::all_of(name.begin() + 4, name.end(), [](unsigned char c){ return std::isdigit(c); })){
+                continue;
+            }
+
+            std::ifstream file(entry.path() / "cpulist");
+            std::string list;
+            if (!std::getline(file, list)){
+                continue;
+            }
+
+            std::vector<unsigned> cpus = parse_cpulist(list);
+            if (!cpus.empty()){
+                found.emplace_back(std::stoul(name.substr(4)), std::move(cpus));
+            }
+        }
+
+        std::sort(found.begin(), found.end());
+
+        for (auto& [id, cpus] : found){
+            for (unsigned cpu : cpus){
+                if (cpu >= node_of_cpu_.size()){
+                    node_of_cpu_.resize(cpu + 1, 0);
+                }
+                node_of_cpu_[cpu] = cpus_.size();
+            }
+            cpus_.push_back(std::move(cpus));
+        }
+    }
+
+    // At least 1, an unknown topology is a single node
+    size_type node_count() const{
+        return std::max<size_type>(cpus_.size(), 1);
+    }
+
+    // The CPUs of `node` (none if the topology is unknown)
+    const std::vector<unsigned>& cpus(size_type node) const{
+        static const std::vector<unsigned> none;
+        return node < cpus_.size() ? cpus_[node] : none;
+    }
+
+    size_type node_of(unsigned cpu) const{
+        return cpu < node_of_cpu_.size() ? node_of_cpu_[cpu] : 0;
+    }
+
+    // The node of the CPU the calling thread runs on (the thread can be migrated right after)
+    size_type current_node() const{
+#ifdef __linux__
+        if (cpus_.size() > 1){
+            int cpu = sched_getcpu();
+            if (cpu >= 0){
+                return node_of(static_cast<unsigned>(cpu));
+            }
+        }
+#endif
+        return 0;
+    }
+
+    // Call `function` on a thread bound to the CPUs of `node`, or on the calling thread if there is a single node.
+    template<class Function>
+    void run_on(size_type node, Function function) const{
+#ifdef __linux__
+        if (cpus_.size() > 1){
+            std::thread worker([&]{
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for (unsigned cpu : cpus_[node]){
+                    if (cpu < CPU_SETSIZE){
+                        CPU_SET(cpu, &set);
+                    }
+                }
+
+                // Not being bound only costs the placement
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                function();
+            });
+            worker.join();
+            return;
+        }
+#endif
+        function();
+    }
+
+private:
+
+    // The CPUs of every node
+    std::vector<std::vector<unsigned>> cpus_;
+    std::vector<size_type> node_of_cpu_;
+
+    // "0-3,8-11" -> 0 1 2 3 8 9 10 11
+    static std::vector<unsigned> parse_cpulist(const std::string& list){
+
+        std::vector<unsigned> result;
+
+        const char* at = list.data();
+        const char* end = list.data() + list.size();
+        while (at < end){
+            unsigned first = 0;
+            auto [next, error] = std::from_chars(at, end, first);
+            if (error != std::errc{}){
+                break;
+            }
+
+            unsigned last = first;
+            if (next != end && *next == '-'){
+                auto [after, range_error] = std::from_chars(next + 1, end, last);
+                if (range_error != std::errc{}){
+                    break;
+                }
+                next = after;
+            }
+
+            for (unsigned cpu = first; cpu <= last; ++cpu){
+                result.push_back(cpu);
+            }
+
+            at = next != end && *next == ',' ? next + 1 : end;
+        }
+
+        return result;
+    }
+};
+
+// Lockable, for basic_locker<FairnessPolicy, cohort_mutex> (with std::condition_variable_any).
+class cohort_mutex{
+public:
+
+    using size_type = std::size_t;
+
+    // How many times in a row the global lock is passed on within a node before the other nodes get their turn
+    static constexpr unsigned max_handoffs = 64;
+
+    cohort_mutex() : cohort_mutex(numa_topology::system()) {}
+
+    explicit cohort_mutex(const numa_topology& topology)
+        : topology_(&topology),
+          cohorts_(std::make_unique<Cohort[]>(topology.node_count())) {}
+
+    cohort_mutex(const cohort_mutex&) = delete;
+    cohort_mutex& operator=(const cohort_mutex&) = delete;
+
+    void lock(){
+
+        Cohort& cohort = cohorts_[topology_->current_node()];
+
+        cohort.waiting.fetch_add(1, std::memory_order_relaxed);
+        cohort.mtx.lock();
+        cohort.waiting.fetch_sub(1, std::memory_order_relaxed);
+
+        if (!cohort.owns_global && is_distributed()){
+            global_.acquire();
+        }
+
+        owner_ = &cohort;
+    }
+
+    bool try_lock(){
+
+        Cohort& cohort = cohorts_[topology_->current_node()];
+
+        if (!cohort.mtx.try_lock()){
+            return false;
+        }
+
+        if (!cohort.owns_global && is_distributed() && !global_.try_acquire()){
+            cohort.mtx.unlock();
+            return false;
+        }
+
+        owner_ = &cohort;
+        return true;
+    }
+
+    void unlock(){
+
+        // The thread might run on another node by now
+        Cohort& cohort = *owner_;
+
+        if (is_distributed()){
+            if (cohort.waiting.load(std::memory_order_relaxed) > 0 && cohort.handoffs < max_handoffs){
+                // Whoever takes the local lock next finds the global one taken for it
+                ++cohort.handoffs;
+                cohort.owns_global = true;
+            }
+            else{
+                cohort.handoffs = 0;
+                cohort.owns_global = false;
+                global_.release();
+            }
+        }
+
+        cohort.mtx.unlock();
+    }
+
+private:
+
+    // The local lock of a node, on its own cache lines
+    struct alignas(64) Cohort{
+        std::mutex mtx;
+
+        // Threads of the node blocked on mtx
+        std::atomic<size_type> waiting{0};
+
+        // The last owner passed the global lock on (guarded by mtx)
+        bool owns_global = false;
+        unsigned handoffs = 0;
+    };
+
+    const numa_topology* topology_;
+    std::unique_ptr<Cohort[]> cohorts_;
+
+    // Released by whichever thread of the cohort unlocks last, so not a std::mutex
+    std::binary_semaphore global_{1};
+
+    // The cohort of the owner (guarded by the lock itself)
+    Cohort* owner_ = nullptr;
+
+    bool is_distributed() const{
+        return topology_->node_count() > 1;
+    }
+};
+
+template<class FairnessPolicy = reader_preferring>
+class basic_numa_locker;
+
+using numa_locker = basic_numa_locker<>;
+
+template<class FairnessPolicy>
+class basic_numa_locker : public basic_sharded_locker<FairnessPolicy, cohort_mutex> {
+public:
+
+    using base_type = basic_sharded_locker<FairnessPolicy, cohort_mutex>;
+    using size_type = typename base_type::size_type;
+
+    static constexpr size_type default_shards_per_node = 4;
+
+    // Tree nodes every partition preallocates on its home node
+    static constexpr size_type initial_reserve = 256;
+
+    // [0, key_space) is split among the nodes in order, shards_per_node partitions each (one partition on a single node).
+    explicit basic_numa_locker(size_type shards_per_node = default_shards_per_node, size_type key_space = std::numeric_limits<size_type>::max())
+        : base_type(numa_topology::system().node_count() * partitions_per_node(shards_per_node), key_space),
+          shards_per_node_(partitions_per_node(shards_per_node)){
+
+        const numa_topology& topology = numa_topology::system();
+        for (size_type node = 0; node < topology.node_count(); ++node){
+            topology.run_on(node, [&]{
+                for (size_type i = 0; i < shards_per_node_; ++i){
+                    this->reserve_shard(node * shards_per_node_ + i, initial_reserve);
+                }
+            });
+        }
+    }
+
+    size_type node_count() const{
+        return this->shard_count() / shards_per_node_;
+    }
+
+    // The node partition `shard` is homed on
+    size_type home_of(size_type shard) const{
+        return shard / shards_per_node_;
+    }
+
+private:
+    size_type shards_per_node_;
+
+    static size_type partitions_per_node(size_type shards_per_node){
+        return numa_topology::system().node_count() > 1 ? shards_per_node : 1;
+    }
+};
+
+#endif //INTERVAL_LOCK_NUMA_LOCKER_HPP
@@ -0,0 +1,158 @@
+#ifndef POOL_ALLOCATOR_HPP_
+#define POOL_ALLOCATOR_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Slab allocator for fixed-size objects (tree nodes).
+//
+// Single-object allocations are served from slabs owned by the allocator
+// instance and recycled through an intrusive free list, so once the pool
+// has grown to the working-set size neither allocate nor deallocate
+// touches the global heap. The memory is returned only when the pool is
+// destroyed.
+//
+// Every instance owns its own pool: copies (and rebound copies) start
+// empty and two distinct instances never compare equal. The allocator is
+// not thread-safe, the owning container is expected to be externally
+// synchronized.
+template<class T>
+class pool_allocator {
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using propagate_on_container_copy_assignment = std::false_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+	using is_always_equal = std::false_type;
+
+	template<class U>
+	struct rebind {
+		using other = pool_allocator<U>;
+	};
+
+	static constexpr size_type initial_slab_size = 64;
+	static constexpr size_type maximum_slab_size = 4096;
+
+	pool_allocator() noexcept = default;
+
+	// a copy does not share the pool, it starts with an empty one
+	pool_allocator(const pool_allocator &) noexcept {}
+
+	template<class U>
+	pool_allocator(const pool_allocator<U> &) noexcept {}
+
+	pool_allocator(pool_allocator &&other) noexcept
+		: slabs_(std::move(other.slabs_)),
+		  free_(std::exchange(other.free_, nullptr)),
+		  free_count_(std::exchange(other.free_count_, 0)),
+		  next_slab_size_(std::exchange(other.next_slab_size_, initial_slab_size)) {}
+
+	pool_allocator &operator=(const pool_allocator &) noexcept {
+		return *this;
+	}
+
+	pool_allocator &operator=(pool_allocator &&other) noexcept {
+		if (this != &other) {
+			release();
+			slabs_ = std::move(other.slabs_);
+			free_ = std::exchange(other.free_, nullptr);
+			free_count_ = std::exchange(other.free_count_, 0);
+			next_slab_size_ = std::exchange(other.next_slab_size_, initial_slab_size);
+		}
+
+		return *this;
+	}
+
+	~pool_allocator() {
+		release();
+	}
+
+	T *allocate(size_type n) {
+		if (n != 1) {
+			// only single objects are pooled
+			return std::allocator<T>().allocate(n);
+		}
+
+		if (free_ == nullptr)
+			grow(next_slab_size_);
+
+		slot *result = free_;
+		free_ = free_->next;
+		--free_count_;
+
+		return reinterpret_cast<T *>(result->storage);
+	}
+
+	void deallocate(T *p, size_type n) noexcept {
+		if (n != 1) {
+			std::allocator<T>().deallocate(p, n);
+			return;
+		}
+
+		slot *freed = reinterpret_cast<slot *>(p);
+		freed->next = free_;
+		free_ = freed;
+		++free_count_;
+	}
+
+	// makes sure that the next `n` single-object allocations are served without growing the pool
+	void reserve(size_type n) {
+		if (free_count_ < n)
+			grow(n - free_count_);
+	}
+
+	// the number of objects that can be allocated without growing the pool
+	size_type available() const noexcept {
+		return free_count_;
+	}
+
+	friend bool operator==(const pool_allocator &a, const pool_allocator &b) noexcept {
+		return &a == &b;
+	}
+
+private:
+	union slot {
+		slot *next;
+		alignas(T) std::byte storage[sizeof(T)];
+	};
+
+	void grow(size_type count) {
+		assert(count > 0);
+
+		slot *slab = std::allocator<slot>().allocate(count);
+		slabs_.emplace_back(slab, count);
+
+		// thread the new slots onto the free list (in address order)
+		for (size_type i = count; i > 0; --i) {
+			slab[i - 1].next = free_;
+			free_ = &slab[i - 1];
+		}
+
+		free_count_ += count;
+		next_slab_size_ = std::min(std::max(next_slab_size_, count) * 2, maximum_slab_size);
+	}
+
+	void release() noexcept {
+		for (auto [slab, count] : slabs_)
+			std::allocator<slot>().deallocate(slab, count);
+
+		slabs_.clear();
+		free_ = nullptr;
+		free_count_ = 0;
+		next_slab_size_ = initial_slab_size;
+	}
+
+	std::vector<std::pair<slot *, size_type>> slabs_;
+	slot *free_ = nullptr;
+	size_type free_count_ = 0;
+	size_type next_slab_size_ = initial_slab_size;
+};
+
+#endif // POOL_ALLOCATOR_HPP_
@@ -0,0 +1,273 @@
+#ifndef INTERVAL_LOCK_RANGE_LOCKER_HPP
+#define INTERVAL_LOCK_RANGE_LOCKER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include "basic_lock.hpp"
+#include "interval_tree.hpp"
+#include "pool_allocator.hpp"
+
+// Alternative locker engine following the range_lock of the Linux kernel.
+//
+// Every request (granted or not) is put into the tree the moment it arrives and counts the conflicting requests
+// that are already there (i.e. the earlier ones). A release decrements the counts of the later conflicting
+// requests and wakes up exactly those that reach zero. Conflicting requests are therefore granted in FIFO order
+// and nobody re-evaluates a predicate.
+//
+// Unlike `locker`, blocking is transitive here: a waiting request blocks the later requests it conflicts with.
+
+class range_locker;
+struct RangeRequest;
+
+// All the requests for one interval
+struct RangeList{
+    RangeRequest* head;
+    RangeRequest* tail;
+};
+
+using range_tree = interval_tree<RangeList, pool_allocator<RangeList>>;
+
+struct RangeRequest{
+
+    // Number of requests this one waits for, 0 == granted
+    std::size_t blocking = 0;
+
+    // Arrival order
+    std::uint64_t sequence = 0;
+
+    bool is_exclusive = false;
+
+    // Set while a granted shared request waits to become exclusive, it then waits for the granted requests
+    // that arrived later as well (and nothing else can be granted in the meantime)
+    bool is_upgrading = false;
+
+    // Requests for the same interval form a doubly linked list
+    RangeRequest* prev = nullptr;
+    RangeRequest* next = nullptr;
+    range_tree::node* node = nullptr;
+
+    // The waiting thread parks here
+    std::condition_variable cv;
+};
+
+using range_shared_lock = basic_shared_lock<range_locker, RangeRequest*>;
+using range_exclusive_lock = basic_exclusive_lock<range_locker, RangeRequest*>;
+using range_lock_set = basic_lock_set<range_locker, RangeRequest*>;
+
+class range_locker {
+public:
+
+    using shared_lock = range_shared_lock;
+    using exclusive_lock = range_exclusive_lock;
+    using lock_set = range_lock_set;
+
+    friend shared_lock;
+    friend exclusive_lock;
+    friend lock_set;
+
+    using size_type = std::size_t;
+    using node_handle = RangeRequest*;
+
+    range_locker() = default;
+
+    range_locker(const range_locker&) = delete;
+    range_locker(range_locker&&) = delete;
+    range_locker& operator=(const range_locker&) = delete;
+    range_locker& operator=(range_locker&&) = delete;
+
+    ~range_locker(){
+
+        // Wait until all the requests are gone.
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return requests.empty(); });
+    }
+
+    shared_lock lock_shared(size_type b, size_type e){
+        return shared_lock(this, acquire(b, e, false));
+    }
+
+    exclusive_lock lock_exclusive(size_type b, size_type e){
+        return exclusive_lock(this, acquire(b, e, true));
+    }
+
+    // Preallocate the records for `n` more simultaneous requests.
+    void reserve(size_type n){
+        std::unique_lock<std::mutex> lock(mtx);
+        requests.reserve(n);
+        request_pool.reserve(n);
+    }
+
+private:
+
+    std::mutex mtx;
+
+    // Signalled when `requests` becomes empty (~range_locker waits for it)
+    std::condition_variable cv;
+    range_tree requests;
+    pool_allocator<RangeRequest> request_pool;
+    std::uint64_t next_sequence = 0;
+
+    static bool conflicts(const RangeRequest& a, const RangeRequest& b){
+        return a.is_exclusive || b.is_exclusive;
+    }
+
+    template<class Visitor>
+    void for_each_overlapping_request(range_tree::key_type key, Visitor visitor){
+        requests.for_each_overlap(key, [&](range_tree::node* it){
+            for (RangeRequest* request = it->value.head; request != nullptr; request = request->next){
+                visitor(*request);
+            }
+        });
+    }
+
+    static void unblock(RangeRequest& request){
+        if (--request.blocking == 0){
+            request.cv.notify_one();
+        }
+    }
+
+    RangeRequest* acquire(size_type b, size_type e, bool is_exclusive){
+
+        std::unique_lock<std::mutex> lock(mtx);
+
+        RangeRequest* request = std::construct_at(request_pool.allocate(1));
+        request->sequence = next_sequence++;
+        request->is_exclusive = is_exclusive;
+
+        // Everything in the tree arrived earlier, count what we conflict with
+        for_each_overlapping_request({b, e}, [&](RangeRequest& other){
+            if (conflicts(*request, other)){
+                request->blocking++;
+            }
+        });
+
+        link(request, {b, e});
+
+        while (request->blocking != 0){
+            request->cv.wait(lock);
+        }
+
+        return request;
+    }
+
+    void link(RangeRequest* request, range_tree::key_type key){
+        auto it = requests.emplace(key, RangeList{nullptr, nullptr}).first;
+
+        request->node = it;
+        request->prev = it->value.tail;
+        if (request->prev != nullptr){
+            request->prev->next = request;
+        }
+        else{
+            it->value.head = request;
+        }
+        it->value.tail = request;
+    }
+
+    void unlink(RangeRequest* request){
+        auto it = request->node;
+
+        (request->prev != nullptr ? request->prev->next : it->value.head) = request->next;
+        (request->next != nullptr ? request->next->prev : it->value.tail) = request->prev;
+
+        if (it->value.head == nullptr){
+            requests.erase(it);
+        }
+    }
+
+    void release(RangeRequest* request){
+        std::unique_lock<std::mutex> lock(mtx);
+        release_locked(request);
+    }
+
+    void release_locked(RangeRequest* request){
+        auto key = request->node->key;
+        unlink(request);
+
+        // The later conflicting requests counted this one (an upgrading request counted the granted ones as well)
+        for_each_overlapping_request(key, [&](RangeRequest& other){
+            if (other.blocking != 0 && conflicts(*request, other)
+                && (request->sequence < other.sequence || (other.is_upgrading && request->blocking == 0))){
+                unblock(other);
+            }
+        });
+
+        std::destroy_at(request);
+        request_pool.deallocate(request, 1);
+
+        if (requests.empty()){
+            cv.notify_all();
+        }
+    }
+
+    void unlock_shared(RangeRequest* request){
+        release(request);
+    }
+
+    void unlock_exclusive(RangeRequest* request){
+        release(request);
+    }
+
+    void unlock_many(std::span<RangeRequest* const> batch){
+        std::unique_lock<std::mutex> lock(mtx);
+
+        for (auto request : batch){
+            release_locked(request);
+        }
+    }
+
+    shared_lock actual_downgrade(RangeRequest* request){
+
+        std::unique_lock<std::mutex> lock(mtx);
+
+        // The later shared requests no longer conflict with us
+        for_each_overlapping_request(request->node->key, [&](RangeRequest& other){
+            if (other.blocking != 0 && !other.is_exclusive && request->sequence < other.sequence){
+                unblock(other);
+            }
+        });
+
+        request->is_exclusive = false;
+
+        return shared_lock(this, request);
+    }
+
+    exclusive_lock actual_upgrade(RangeRequest* request){
+
+        std::unique_lock<std::mutex> lock(mtx);
+
+        // The request keeps its place in the queue:
+        // - it waits for every earlier overlapping request and for the later ones that are already granted,
+        // - the later shared requests still waiting now have to wait for it as well
+        //   (the later exclusive ones counted it already).
+        for_each_overlapping_request(request->node->key, [&](RangeRequest& other){
+            if (&other == request){
+                return;
+            }
+
+            if (other.sequence < request->sequence || other.blocking == 0){
+                request->blocking++;
+            }
+            else if (!other.is_exclusive){
+                other.blocking++;
+            }
+        });
+
+        request->is_exclusive = true;
+        request->is_upgrading = true;
+
+        while (request->blocking != 0){
+            request->cv.wait(lock);
+        }
+
+        request->is_upgrading = false;
+
+        return exclusive_lock(this, request);
+    }
+
+};
+
+#endif //INTERVAL_LOCK_RANGE_LOCKER_HPP
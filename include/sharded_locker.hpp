@@ -0,0 +1,496 @@
+#ifndef INTERVAL_LOCK_SHARDED_LOCKER_HPP
+#define INTERVAL_LOCK_SHARDED_LOCKER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "basic_lock.hpp"
+#include "locker.hpp"
+
+// Locker engine that partitions the key space into independent lockers (each with its own mutex, tree and waiters),
+// so threads locking disjoint regions of the key space do not serialize on a single mutex.
+//
+// [0, key_space) is split into equal partitions (the last one extends to SIZE_MAX). An interval spanning several
+// partitions is split into one piece per partition, the pieces are acquired from left to right (so two such
+// requests can never wait for each other's pieces), and released together.
+//
+// In the adaptive mode the boundaries follow the load: a partition that got more than twice the acquisitions of
+// a neighbour hands the part of its key range between the neighbour and the mean key of its acquisitions over to it
+// (only the partitions involved are locked meanwhile). The held intervals of that range are moved to the
+// neighbour's tree (split/join, the nodes stay where they are), a boundary never goes through a held interval. The waiters of that range start over in the neighbour.
+
+// Mutex is the mutex of every partition (see basic_locker).
+template<class FairnessPolicy = reader_preferring, class Mutex = std::mutex>
+class basic_sharded_locker;
+
+using sharded_locker = basic_sharded_locker<>;
+
+// How basic_sharded_locker partitions the key space
+enum class sharding{
+
+    // The partitions never change
+    fixed,
+
+    // The boundaries move towards the busy partitions
+    adaptive
+};
+
+// A lock of basic_sharded_locker, the pieces of the interval from left to right. A piece can migrate to another
+// partition, so the partition holding it is looked up (by the key of the piece) whenever it is needed.
+struct ShardedHandle{
+    lock_tree::node* first = nullptr;
+
+    // nullptr for a single piece
+    lock_tree::node* last = nullptr;
+
+    // Pieces in between, allocated only for intervals spanning more than two partitions. Shared by the copies of the
+    // handle, so a handle given away by release() frees them with its last copy (the pieces stay locked).
+    std::shared_ptr<std::vector<lock_tree::node*>> middle;
+};
+
+using sharded_shared_lock = basic_shared_lock<sharded_locker, ShardedHandle>;
+using sharded_exclusive_lock = basic_exclusive_lock<sharded_locker, ShardedHandle>;
+
+template<class FairnessPolicy, class Mutex>
+class basic_sharded_locker {
+public:
+
+    using shard_type = basic_locker<FairnessPolicy, Mutex>;
+    using shared_lock = basic_shared_lock<basic_sharded_locker, ShardedHandle>;
+    using exclusive_lock = basic_exclusive_lock<basic_sharded_locker, ShardedHandle>;
+
+    friend shared_lock;
+    friend exclusive_lock;
+
+    using size_type = std::size_t;
+    using node_handle = ShardedHandle;
+    using fairness_policy = FairnessPolicy;
+
+    static constexpr size_type default_shard_count = 16;
+
+    // An adaptive partition compares its load with its neighbours' after this many acquisitions
+    static constexpr size_type rebalance_interval = 1024;
+
+    explicit basic_sharded_locker(size_type shard_count = default_shard_count, size_type key_space = std::numeric_limits<size_type>::max(),
+                                  sharding mode = sharding::fixed)
+        : shard_count_(shard_count),
+          mode_(mode),
+          shards_(std::make_unique<Shard[]>(shard_count)),
+          bounds_(std::make_unique<std::atomic<size_type>[]>(shard_count)){
+
+        assert(shard_count > 0);
+
+        size_type width = std::max<size_type>(1, key_space / shard_count + (key_space % shard_count != 0));
+        for (size_type i = 0; i < shard_count; ++i){
+            shards_[i].lo = i * width;
+            shards_[i].hi = i + 1 == shard_count ? std::numeric_limits<size_type>::max() : (i + 1) * width;
+            bounds_[i].store(shards_[i].lo, std::memory_order_relaxed);
+        }
+    }
+
+    basic_sharded_locker(const basic_sharded_locker&) = delete;
+    basic_sharded_locker(basic_sharded_locker&&) = delete;
+    basic_sharded_locker& operator=(const basic_sharded_locker&) = delete;
+    basic_sharded_locker& operator=(basic_sharded_locker&&) = delete;
+
+    // Every partition waits until its locks are released before any of them is destroyed: a node handed over to a
+    // neighbour stays in the pool of the partition it was allocated by.
+    ~basic_sharded_locker(){
+        for (size_type i = 0; i < shard_count_; ++i){
+            shards_[i].locker.wait_until_idle();
+        }
+    }
+
+    shared_lock lock_shared(size_type b, size_type e){
+        return acquire<shared_lock, true>(b, e, false);
+    }
+
+    exclusive_lock lock_exclusive(size_type b, size_type e){
+        return acquire<exclusive_lock, true>(b, e, true);
+    }
+
+    // Return an empty handle instead of waiting (the pieces acquired so far are released again).
+
+    shared_lock try_lock_shared(size_type b, size_type e){
+        return acquire<shared_lock, false>(b, e, false);
+    }
+
+    exclusive_lock try_lock_exclusive(size_type b, size_type e){
+        return acquire<exclusive_lock, false>(b, e, true);
+    }
+
+    // Preallocate tree nodes for `n` more simultaneously held intervals in every partition.
+    void reserve(size_type n){
+        for (size_type i = 0; i < shard_count_; ++i){
+            reserve_shard(i, n);
+        }
+    }
+
+    // Preallocate tree nodes for `n` more simultaneously held intervals in partition `shard`.
+    void reserve_shard(size_type shard, size_type n){
+        std::unique_lock<Mutex> lock(shards_[shard].locker.mtx);
+        shards_[shard].locker.inter_tree.reserve(n);
+    }
+
+    size_type shard_count() const{
+        return shard_count_;
+    }
+
+    // The partition `key` belongs to at the moment
+    size_type shard_of(size_type key) const{
+
+        // The last partition starting at or before `key` (the empty ones start where the next one does)
+        size_type lo = 0;
+        size_type hi = shard_count_;
+        while (hi - lo > 1){
+            size_type middle = lo + (hi - lo) / 2;
+            if (bounds_[middle].load(std::memory_order_acquire) <= key){
+                lo = middle;
+            }
+            else{
+                hi = middle;
+            }
+        }
+
+        return lo;
+    }
+
+    // The first key of every partition at the moment
+    std::vector<size_type> boundaries() const{
+        std::vector<size_type> result(shard_count_);
+        for (size_type i = 0; i < shard_count_; ++i){
+            result[i] = bounds_[i].load(std::memory_order_acquire);
+        }
+        return result;
+    }
+
+private:
+
+    using Waiter = typename shard_type::Waiter;
+
+    // Every shard on its own cache lines, the shards' mutexes are not supposed to share them
+    struct alignas(64) Shard{
+        shard_type locker;
+
+        // The keys [lo, hi) belong to the partition (guarded by the partition's mutex)
+        size_type lo = 0;
+        size_type hi = 0;
+
+        // Acquisitions since the partition last compared its load with its neighbours', and the sum of their
+        // middle keys (as a double, only their mean matters)
+        size_type operations = 0;
+        double key_sum = 0;
+
+        bool owns(lock_tree::key_type key) const{
+            return lo <= key.first && key.second <= hi;
+        }
+    };
+
+    // Parks like park_forever, but gives up once the interval no longer belongs to the partition.
+    struct park_while_owned{
+        const Shard* shard;
+        lock_tree::key_type key;
+
+        bool operator()(Waiter& self, std::unique_lock<Mutex>& lock) const{
+            if (!shard->owns(key)){
+                return false;
+            }
+
+            self.cv.wait(lock);
+            return shard->owns(key);
+        }
+    };
+
+    size_type shard_count_;
+    sharding mode_;
+    std::unique_ptr<Shard[]> shards_;
+
+    // bounds_[i] == shards_[i].lo, to find a partition without taking the mutexes
+    std::unique_ptr<std::atomic<size_type>[]> bounds_;
+
+    // Lock the mutex of the partition owning `key`. The boundaries might move in the meantime, so the ownership
+    // is checked once more under the mutex.
+    Shard& lock_owner(lock_tree::key_type key, std::unique_lock<Mutex>& lock){
+        while (true){
+            Shard& shard = shards_[shard_of(key.first)];
+
+            lock = std::unique_lock<Mutex>(shard.locker.mtx);
+            if (shard.owns(key)){
+                return shard;
+            }
+
+            lock.unlock();
+        }
+    }
+
+    template<class Visitor>
+    static void for_each_piece(ShardedHandle& handle, Visitor visitor){
+        if (handle.first != nullptr){
+            visitor(handle.first);
+        }
+
+        if (handle.middle != nullptr){
+            for (auto& node : *handle.middle){
+                visitor(node);
+            }
+        }
+
+        if (handle.last != nullptr){
+            visitor(handle.last);
+        }
+    }
+
+    // Make room for one more piece, before it is acquired (may throw)
+    static void reserve_piece(ShardedHandle& handle){
+        if (handle.last == nullptr){
+            return;
+        }
+
+        if (handle.middle == nullptr){
+            handle.middle = std::make_shared<std::vector<lock_tree::node*>>();
+        }
+        if (handle.middle->size() == handle.middle->capacity()){
+            handle.middle->reserve(std::max<size_type>(4, 2 * handle.middle->size()));
+        }
+    }
+
+    // (never throws after reserve_piece)
+    static void push_piece(ShardedHandle& handle, lock_tree::node* node) noexcept{
+        if (handle.first == nullptr){
+            handle.first = node;
+        }
+        else if (handle.last == nullptr){
+            handle.last = node;
+        }
+        else{
+            handle.middle->push_back(handle.last);
+            handle.last = node;
+        }
+    }
+
+    template<class Lock, bool Blocking>
+    Lock acquire(size_type b, size_type e, bool is_exclusive){
+
+        assert(b < e);
+
+        ShardedHandle handle;
+        size_type at = b;
+
+        // Piece by piece, from left to right
+        while (at < e){
+            try{
+                reserve_piece(handle);
+            }
+            catch (...){
+                release_pieces(handle, is_exclusive);
+                throw;
+            }
+
+            std::unique_lock<Mutex> lock;
+            Shard& shard = lock_owner({at, at + 1}, lock);
+
+            lock_tree::key_type key{at, std::min(e, shard.hi)};
+            auto owned = [&]{ return shard.owns(key); };
+
+            lock_tree::node* node;
+            if constexpr (Blocking){
+                node = shard.locker.acquire_locked(lock, key, is_exclusive, park_while_owned{&shard, key}, owned);
+            }
+            else{
+                node = shard.locker.acquire_locked(lock, key, is_exclusive, typename shard_type::dont_park{}, owned);
+            }
+
+            if (node == nullptr){
+
+                // The boundaries moved, this piece has to be acquired anew
+                if (!owned()){
+                    continue;
+                }
+
+                lock.unlock();
+                release_pieces(handle, is_exclusive);
+                return Lock();
+            }
+
+            push_piece(handle, node);
+            at = key.second;
+
+            bool check_load = false;
+            if (mode_ == sharding::adaptive){
+                shard.key_sum += static_cast<double>(key.first + (key.second - key.first) / 2);
+                check_load = ++shard.operations >= rebalance_interval;
+            }
+            lock.unlock();
+
+            if (check_load){
+                rebalance(&shard - shards_.get());
+            }
+        }
+
+        return Lock(this, handle);
+    }
+
+    // Unlock the pieces (the middle ones are freed with the last copy of the handle)
+    void release_pieces(ShardedHandle& handle, bool is_exclusive){
+        for_each_piece(handle, [&](lock_tree::node* node){
+            std::unique_lock<Mutex> lock;
+            Shard& shard = lock_owner(node->key, lock);
+
+            if (is_exclusive){
+                shard.locker.unlock_exclusive(node, lock);
+            }
+            else{
+                shard.locker.unlock_shared(node, lock);
+            }
+        });
+    }
+
+    void unlock_shared(ShardedHandle handle){
+        release_pieces(handle, false);
+    }
+
+    void unlock_exclusive(ShardedHandle handle){
+        release_pieces(handle, true);
+    }
+
+    exclusive_lock actual_upgrade(ShardedHandle handle){
+        for_each_piece(handle, [&](lock_tree::node* node){
+
+            // Only gives up if the piece migrates meanwhile
+            while (true){
+                std::unique_lock<Mutex> lock;
+                Shard& shard = lock_owner(node->key, lock);
+
+                if (shard.locker.upgrade_locked(node, lock, park_while_owned{&shard, node->key}, [&]{ return shard.owns(node->key); })){
+                    break;
+                }
+            }
+        });
+
+        return exclusive_lock(this, handle);
+    }
+
+    shared_lock actual_downgrade(ShardedHandle handle){
+        for_each_piece(handle, [&](lock_tree::node* node){
+            std::unique_lock<Mutex> lock;
+            Shard& shard = lock_owner(node->key, lock);
+            shard.locker.downgrade_locked(node, lock);
+        });
+
+        return shared_lock(this, handle);
+    }
+
+    // Hand a part of the key range of partition `i` over to its less loaded neighbour, if `i` had more than twice
+    // its acquisitions. Locks only `i` and its neighbours.
+    void rebalance(size_type i){
+
+        size_type from = i > 0 ? i - 1 : i;
+        size_type to = std::min(i + 1, shard_count_ - 1);
+
+        std::vector<std::unique_lock<Mutex>> locks;
+        locks.reserve(3);
+        for (size_type j = from; j <= to; ++j){
+            locks.emplace_back(shards_[j].locker.mtx);
+        }
+
+        Shard& shard = shards_[i];
+        if (shard.operations < rebalance_interval){
+            // Somebody else did it already
+            return;
+        }
+
+        if (from != to){
+            size_type neighbour = from;
+            if (from == i || (to != i && shards_[to].operations < shards_[from].operations)){
+                neighbour = to;
+            }
+
+            if (shard.operations > 2 * shards_[neighbour].operations){
+                hand_over(i, neighbour);
+            }
+        }
+
+        // The neighbours' history counts half
+        for (size_type j = from; j <= to; ++j){
+            shards_[j].operations = j == i ? 0 : shards_[j].operations / 2;
+            shards_[j].key_sum = j == i ? 0 : shards_[j].key_sum / 2;
+        }
+    }
+
+    // Move the keys of partition `i` between `neighbour` and the mean key of the acquisitions over to `neighbour`,
+    // so about half of the load moves. Both partitions are locked.
+    void hand_over(size_type i, size_type neighbour){
+
+        Shard& shard = shards_[i];
+        Shard& other = shards_[neighbour];
+        bool to_right = neighbour > i;
+
+        if (shard.hi - shard.lo < 2){
+            return;
+        }
+
+        double mean = shard.key_sum / static_cast<double>(shard.operations);
+        size_type boundary = shard.lo + 1;
+        if (mean >= static_cast<double>(shard.hi - 1)){
+            boundary = shard.hi - 1;
+        }
+        else if (mean > static_cast<double>(boundary)){
+            boundary = static_cast<size_type>(mean);
+        }
+
+        // The new boundary must not go through a held interval, move it past the ones it would
+        while (true){
+            lock_tree::node* crossing = nullptr;
+            shard.locker.inter_tree.for_each_overlap({boundary - 1, boundary + 1}, [&](lock_tree::node* it){
+                if (it->key.first < boundary && boundary < it->key.second){
+                    crossing = it;
+                    return false;
+                }
+                return true;
+            });
+
+            if (crossing == nullptr){
+                break;
+            }
+
+            boundary = to_right ? crossing->key.second : crossing->key.first;
+            if (boundary <= shard.lo || boundary >= shard.hi){
+                return;
+            }
+        }
+
+        // The held intervals of the range move to the neighbour's tree
+        lock_tree right;
+        shard.locker.inter_tree.split({boundary, 0}, right);
+
+        lock_tree::key_type moved;
+        if (to_right){
+            other.locker.inter_tree.join(right);
+
+            moved = {boundary, shard.hi};
+            shard.hi = boundary;
+            other.lo = boundary;
+            bounds_[neighbour].store(boundary, std::memory_order_release);
+        }
+        else{
+            other.locker.inter_tree.join(shard.locker.inter_tree);
+            shard.locker.inter_tree.join(right);
+
+            moved = {shard.lo, boundary};
+            shard.lo = boundary;
+            other.hi = boundary;
+            bounds_[i].store(boundary, std::memory_order_release);
+        }
+
+        // The waiters of the range have to start over in the neighbour
+        shard.locker.wake_overlapping(moved);
+    }
+
+};
+
+#endif //INTERVAL_LOCK_SHARDED_LOCKER_HPP
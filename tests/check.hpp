@@ -0,0 +1,16 @@
+#ifndef INTERVAL_LOCK_TESTS_CHECK_HPP
+#define INTERVAL_LOCK_TESTS_CHECK_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+
+// Report the line of a failed check and fail the test
+inline void check(bool condition, std::size_t line) {
+    if (!condition) {
+        std::cerr << "FAILURE:" << line << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+#endif //INTERVAL_LOCK_TESTS_CHECK_HPP
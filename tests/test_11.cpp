@@ -0,0 +1,101 @@
+#include <chrono>
+#include <iostream>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+#include "range_locker.hpp"
+
+/*
+    This test checks the range_lock engine (range_locker).
+
+    It offers the same lock handles as `locker`, but conflicting requests are
+    granted in their arrival order, so (unlike with `locker`) a waiting request
+    blocks the later requests it conflicts with.
+*/
+
+void test_handles() {
+    range_locker locker_;
+
+    for (std::size_t i = 0; i < 1000; ++i) {
+        // these two shouldn't block each other
+        auto lock = locker_.lock_exclusive(0 + i, 10 + i);
+        auto lock2 = locker_.lock_exclusive(10 + i, 20 + i);
+
+        // these two shouldn't block each other
+        auto lock3 = locker_.lock_shared(20 + i, 30 + i);
+        auto lock4 = locker_.lock_shared(20 + i, 30 + i);
+    }
+
+    {
+        // moves, explicit unlocks, upgrades and downgrades work
+        auto lock1 = locker_.lock_exclusive(0, 10);
+        auto lock2 = range_locker::exclusive_lock{};
+
+        for (std::size_t i = 0; i < 1000; ++i) {
+            std::swap(lock2, lock1);
+
+            auto shared = lock2.downgrade();
+            lock2 = shared.upgrade();
+        }
+
+        lock1.unlock();
+        lock2.unlock();
+
+        auto lock3 = locker_.lock_shared(0, 10);
+        auto lock4 = locker_.lock_shared(5, 15);
+        lock3.unlock();
+
+        auto lock5 = lock4.upgrade();
+    }
+}
+
+void test_fifo() {
+    using namespace std::chrono_literals;
+
+    range_locker locker_;
+    std::binary_semaphore semaphore(0);
+
+    // |-----|        held
+    //    |-----|     queued exclusive
+    //         |---|  must wait for the queued one
+    auto lock = locker_.lock_exclusive(0, 10);
+
+    std::jthread queued([&locker_, &semaphore](std::stop_token stoken) {
+        semaphore.release();
+        auto lock2 = locker_.lock_exclusive(5, 15);
+
+        if (!stoken.stop_requested()) {
+            std::cerr << "FAILURE:" << __LINE__ << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        std::this_thread::sleep_for(100ms);
+    });
+
+    semaphore.acquire();
+    std::this_thread::sleep_for(100ms); // give `queued` time to enqueue
+
+    std::jthread later([&locker_, &semaphore](std::stop_token stoken) {
+        semaphore.release();
+        auto lock3 = locker_.lock_shared(12, 20);
+
+        if (!stoken.stop_requested()) {
+            std::cerr << "FAILURE:" << __LINE__ << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    });
+
+    semaphore.acquire();
+    std::this_thread::sleep_for(100ms); // give `later` time to fail
+
+    queued.request_stop();
+    later.request_stop();
+    lock.unlock();
+}
+
+int main() {
+    test_handles();
+    test_fifo();
+    std::cout << "OK" << std::endl;
+}
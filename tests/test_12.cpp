@@ -0,0 +1,86 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks try_lock_* and the timed upgrade.
+
+    A failed attempt returns an empty handle (and a failed upgrade keeps
+    the shared lock), the timed variants give up only at the deadline.
+*/
+
+void run_test() {
+    using namespace std::chrono_literals;
+    auto timeout = 100ms;
+    auto tolerance = 50ms;
+
+    locker locker_;
+
+    {
+        auto lock = locker_.try_lock_exclusive(0, 10);
+        check(bool(lock), __LINE__);
+
+        check(!locker_.try_lock_exclusive(5, 15), __LINE__);
+        check(!locker_.try_lock_shared(0, 10), __LINE__);
+        check(bool(locker_.try_lock_shared(10, 20)), __LINE__);
+
+        auto start = std::chrono::steady_clock::now();
+        check(!locker_.try_lock_shared_for(5, 15, timeout), __LINE__);
+        auto dur = std::chrono::steady_clock::now() - start;
+        check(dur >= timeout && dur < timeout + tolerance, __LINE__);
+
+        // succeeds once the lock is released before the deadline
+        std::jthread thread([&lock, timeout]() {
+            std::this_thread::sleep_for(timeout / 2);
+            lock.unlock();
+        });
+
+        auto lock2 = locker_.try_lock_exclusive_for(5, 15, 10 * timeout);
+        check(bool(lock2), __LINE__);
+    }
+
+    {
+        auto lock1 = locker_.lock_shared(0, 10);
+        auto lock2 = locker_.lock_shared(0, 10);
+
+        // the upgrade has to wait for `lock2`
+        auto start = std::chrono::steady_clock::now();
+        auto upgraded = lock1.try_upgrade_until(start + timeout);
+        auto dur = std::chrono::steady_clock::now() - start;
+
+        check(!upgraded && lock1.owns_lock(), __LINE__);
+        check(dur >= timeout && dur < timeout + tolerance, __LINE__);
+
+        // `lock1` is still held
+        lock2.unlock();
+        check(!locker_.try_lock_exclusive(0, 10), __LINE__);
+
+        upgraded = lock1.try_upgrade_for(timeout);
+        check(upgraded && !lock1.owns_lock(), __LINE__);
+        check(!locker_.try_lock_shared(0, 10), __LINE__);
+    }
+
+    {
+        // a writer that gives up no longer holds back the readers (writer_preferring)
+        basic_locker<writer_preferring> other_locker;
+        auto lock = other_locker.lock_shared(0, 10);
+
+        std::jthread thread([&other_locker, timeout]() {
+            check(!other_locker.try_lock_exclusive_for(0, 10, timeout), __LINE__);
+        });
+
+        std::this_thread::sleep_for(timeout / 2);
+        check(!other_locker.try_lock_shared(5, 15), __LINE__);
+
+        auto lock2 = other_locker.try_lock_shared_for(5, 15, 2 * timeout);
+        check(bool(lock2), __LINE__);
+    }
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+}
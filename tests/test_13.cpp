@@ -0,0 +1,187 @@
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the coroutine variants async_lock_shared/async_lock_exclusive.
+
+    A contended request suspends the coroutine (the thread goes on), it is
+    handed to the executor once an overlapping lock is released. Many
+    coroutines contending for the same interval on a small thread pool
+    still exclude each other.
+*/
+
+// Fire and forget coroutine
+struct task {
+    struct promise_type {
+        task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Collects the coroutines, the test resumes them by hand
+struct queue_executor {
+    std::deque<std::coroutine_handle<>>* queue;
+
+    void operator()(std::coroutine_handle<> handle) const {
+        queue->push_back(handle);
+    }
+};
+
+struct thread_pool {
+    std::mutex mtx;
+    std::condition_variable_any cv;
+    std::deque<std::coroutine_handle<>> queue;
+    std::vector<std::jthread> threads;
+
+    explicit thread_pool(std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            threads.emplace_back([this](std::stop_token token) {
+                while (true) {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, token, [this] { return !queue.empty(); });
+                    if (queue.empty()) {
+                        return;
+                    }
+
+                    auto handle = queue.front();
+                    queue.pop_front();
+                    lock.unlock();
+                    handle.resume();
+                }
+            });
+        }
+    }
+
+    void post(std::coroutine_handle<> handle) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            queue.push_back(handle);
+        }
+        cv.notify_one();
+    }
+};
+
+struct pool_executor {
+    thread_pool* pool;
+
+    void operator()(std::coroutine_handle<> handle) const {
+        pool->post(handle);
+    }
+};
+
+// Suspends, the test resumes the coroutine from the queue
+struct suspend_into {
+    std::deque<std::coroutine_handle<>>* queue;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) const { queue->push_back(handle); }
+    void await_resume() const noexcept {}
+};
+
+task read(locker& locker_, std::deque<std::coroutine_handle<>>& queue, int& stage) {
+    auto lock = co_await locker_.async_lock_shared(5, 15, queue_executor{&queue});
+    stage = 1;
+    co_await suspend_into{&queue};
+    lock.unlock();
+    stage = 2;
+}
+
+task write(locker& locker_, int& stage) {
+    auto lock = co_await locker_.async_lock_exclusive(0, 10);
+    stage = 1;
+}
+
+task increment(locker& locker_, thread_pool& pool, std::size_t& counter, std::atomic<std::size_t>& done) {
+    {
+        auto lock = co_await locker_.async_lock_exclusive(0, 10, pool_executor{&pool});
+        std::size_t value = counter;
+        std::this_thread::yield();
+        counter = value + 1;
+    }
+    done++;
+}
+
+void resume_front(std::deque<std::coroutine_handle<>>& queue) {
+    auto handle = queue.front();
+    queue.pop_front();
+    handle.resume();
+}
+
+void run_test() {
+    locker locker_;
+
+    {
+        std::deque<std::coroutine_handle<>> queue;
+        int reader = 0;
+
+        // uncontended, does not suspend
+        read(locker_, queue, reader);
+        check(reader == 1 && queue.size() == 1, __LINE__);
+        resume_front(queue);
+        check(reader == 2 && queue.empty(), __LINE__);
+    }
+
+    {
+        std::deque<std::coroutine_handle<>> queue;
+        int reader = 0;
+        int writer = 0;
+
+        auto lock = locker_.lock_exclusive(0, 10);
+
+        read(locker_, queue, reader);
+        check(reader == 0 && queue.empty(), __LINE__);
+
+        lock.unlock();
+
+        // granted by the unlock, but not resumed until the executor runs it
+        check(reader == 0 && queue.size() == 1, __LINE__);
+        check(!locker_.try_lock_exclusive(10, 12), __LINE__);
+        resume_front(queue);
+        check(reader == 1, __LINE__);
+
+        // the inline executor resumes the writer within the reader's unlock
+        write(locker_, writer);
+        check(writer == 0, __LINE__);
+        resume_front(queue);
+        check(reader == 2 && writer == 1, __LINE__);
+        check(bool(locker_.try_lock_exclusive(0, 20)), __LINE__);
+    }
+
+    {
+        const std::size_t n = 1000;
+        std::size_t counter = 0;
+        std::atomic<std::size_t> done = 0;
+
+        thread_pool pool(4);
+        auto lock = locker_.lock_shared(5, 6);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            increment(locker_, pool, counter, done);
+        }
+        check(done == 0, __LINE__);
+
+        lock.unlock();
+        while (done != n) {
+            std::this_thread::yield();
+        }
+        check(counter == n, __LINE__);
+    }
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the std::stop_token overloads of lock_shared,
+    lock_exclusive and upgrade.
+
+    A blocked request returns an empty handle right after the stop request
+    (a failed upgrade keeps the shared lock), and the cancelled request no
+    longer holds anybody back.
+*/
+
+void run_test() {
+    using namespace std::chrono_literals;
+    auto delay = 100ms;
+    auto tolerance = 50ms;
+
+    basic_locker<writer_preferring> locker_;
+
+    {
+        auto lock = locker_.lock_shared(0, 10);
+        bool owned = true;
+
+        std::jthread writer([&](std::stop_token token) {
+            owned = bool(locker_.lock_exclusive(5, 15, token));
+        });
+
+        std::this_thread::sleep_for(delay);
+
+        // the waiting writer holds back the readers
+        check(!locker_.try_lock_shared(10, 12), __LINE__);
+
+        auto start = std::chrono::steady_clock::now();
+        writer.request_stop();
+        writer.join();
+        check(std::chrono::steady_clock::now() - start < tolerance, __LINE__);
+        check(!owned, __LINE__);
+
+        // not anymore
+        check(bool(locker_.try_lock_shared(10, 12)), __LINE__);
+    }
+
+    {
+        auto lock = locker_.lock_exclusive(0, 10);
+        bool owned = true;
+
+        std::jthread reader([&](std::stop_token token) {
+            owned = bool(locker_.lock_shared(0, 1, token));
+        });
+
+        std::this_thread::sleep_for(delay);
+        reader.request_stop();
+        reader.join();
+        check(!owned, __LINE__);
+    }
+
+    {
+        // stopped already, does not even wait
+        std::stop_source source;
+        source.request_stop();
+
+        auto lock = locker_.lock_exclusive(0, 10);
+        check(!locker_.lock_exclusive(0, 10, source.get_token()), __LINE__);
+
+        // but it gets a free interval
+        check(bool(locker_.lock_exclusive(10, 20, source.get_token())), __LINE__);
+    }
+
+    {
+        auto lock1 = locker_.lock_shared(0, 10);
+        auto lock2 = locker_.lock_shared(0, 10);
+        bool owned = true;
+
+        std::jthread upgrader([&](std::stop_token token) {
+            owned = bool(lock1.upgrade(token));
+        });
+
+        std::this_thread::sleep_for(delay);
+        upgrader.request_stop();
+        upgrader.join();
+        check(!owned && lock1.owns_lock(), __LINE__);
+
+        // the upgrade goes through once lock2 is gone
+        std::stop_source source;
+        lock2.unlock();
+        auto upgraded = lock1.upgrade(source.get_token());
+        check(upgraded && !lock1.owns_lock(), __LINE__);
+    }
+
+    // a token that can never be stopped
+    check(bool(locker_.lock_exclusive(0, 10, std::stop_token())), __LINE__);
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
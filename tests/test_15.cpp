@@ -0,0 +1,120 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks lock_many.
+
+    The ranges are acquired all-or-nothing: while one of them is taken,
+    the thread waits without holding the others. Releasing the multi lock
+    releases every range at once and wakes up all the overlapping waiters.
+    A waiter queued up behind a lock_many request which was granted one of
+    its ranges gets its lock before that request waits for the next range
+    (with every fairness policy).
+*/
+
+template<class Locker>
+void run_test() {
+    using namespace std::chrono_literals;
+    auto delay = 100ms;
+
+    Locker locker_;
+
+    {
+        // unordered, shared ranges may overlap
+        std::vector<range_request> requests{{40, 50, true}, {0, 10, false}, {5, 15, false}, {20, 30, true}};
+
+        auto lock = locker_.lock_many(requests);
+        check(lock && lock.size() == 4, __LINE__);
+
+        check(!locker_.try_lock_exclusive(45, 46), __LINE__);
+        check(!locker_.try_lock_exclusive(12, 13), __LINE__);
+        check(bool(locker_.try_lock_shared(0, 15)), __LINE__);
+        check(bool(locker_.try_lock_exclusive(30, 40)), __LINE__);
+
+        lock.unlock_all();
+        check(!lock, __LINE__);
+        check(bool(locker_.try_lock_exclusive(0, 50)), __LINE__);
+    }
+
+    {
+        auto lock = locker_.lock_exclusive(20, 30);
+
+        std::vector<range_request> requests{{0, 10, true}, {20, 30, false}};
+        check(!locker_.try_lock_many(requests), __LINE__);
+
+        bool owned = false;
+        std::jthread thread([&]() {
+            auto many = locker_.lock_many(requests);
+            owned = bool(many);
+        });
+
+        std::this_thread::sleep_for(delay);
+
+        // nothing is held while waiting
+        check(!owned, __LINE__);
+        check(bool(locker_.try_lock_exclusive(0, 10)), __LINE__);
+
+        lock.unlock();
+        thread.join();
+        check(owned, __LINE__);
+    }
+
+    {
+        // one release wakes up the waiters of every range
+        std::vector<range_request> requests{{0, 10, true}, {20, 30, true}, {40, 50, false}};
+        auto lock = locker_.lock_many(requests);
+
+        std::atomic<bool> owned[3] = {false, false, false};
+        std::vector<std::jthread> threads;
+        threads.emplace_back([&]() { owned[0] = bool(locker_.lock_exclusive(5, 6)); });
+        threads.emplace_back([&]() { owned[1] = bool(locker_.lock_shared(25, 35)); });
+        threads.emplace_back([&]() { owned[2] = bool(locker_.lock_exclusive(0, 50)); });
+
+        std::this_thread::sleep_for(delay);
+        check(!owned[0] && !owned[1] && !owned[2], __LINE__);
+
+        lock.unlock_all();
+        threads.clear();
+        check(owned[0] && owned[1] && owned[2], __LINE__);
+    }
+
+    {
+        // the writer queued up behind the first range of the multi lock is not left behind while it waits for the
+        // second one, so the holder of the second range can take the first one too
+        auto first = locker_.lock_exclusive(0, 10);
+        auto second = locker_.lock_exclusive(20, 30);
+        std::vector<range_request> requests{{0, 10, false}, {20, 30, false}};
+
+        std::atomic<bool> many_owned{false};
+        std::atomic<bool> writer_owned{false};
+        std::jthread many([&]() { many_owned = bool(locker_.lock_many(requests)); });
+        std::this_thread::sleep_for(delay);
+        std::jthread writer([&]() { writer_owned = bool(locker_.try_lock_exclusive_for(0, 10, 10s)); });
+        std::this_thread::sleep_for(delay);
+
+        first.unlock();
+        auto deadline = std::chrono::steady_clock::now() + 1s;
+        while (!writer_owned && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(1ms);
+        check(writer_owned, __LINE__);
+
+        check(bool(locker_.try_lock_exclusive_for(0, 10, 2s)), __LINE__);
+        second.unlock();
+        many.join();
+        check(many_owned, __LINE__);
+    }
+}
+
+int main() {
+    run_test<locker>();
+    run_test<basic_locker<writer_preferring>>();
+    run_test<basic_locker<fifo_per_overlap>>();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "range_locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks lock_set.
+
+    The set takes over individual locks (leaving them empty) and releases
+    all of them at once, by unlock_all() or when it goes out of scope.
+    The waiters of every released interval are woken up.
+*/
+
+template<class Locker>
+void run_test() {
+    using namespace std::chrono_literals;
+    auto delay = 100ms;
+
+    Locker locker_;
+
+    {
+        typename Locker::lock_set locks;
+        check(!locks, __LINE__);
+
+        for (std::size_t i = 0; i < 1000; ++i) {
+            locks.insert(locker_.lock_exclusive(i * 10, i * 10 + 10));
+        }
+
+        auto lock = locker_.lock_shared(20000, 20010);
+        locks.insert(std::move(lock));
+        check(!lock, __LINE__);
+
+        // an empty lock is ignored
+        locks.insert(typename Locker::exclusive_lock{});
+        check(locks && locks.size() == 1001, __LINE__);
+
+        std::atomic<bool> owned[3] = {false, false, false};
+        std::vector<std::jthread> threads;
+        threads.emplace_back([&]() { owned[0] = bool(locker_.lock_exclusive(5, 6)); });
+        threads.emplace_back([&]() { owned[1] = bool(locker_.lock_shared(9995, 10005)); });
+        threads.emplace_back([&]() { owned[2] = bool(locker_.lock_exclusive(20005, 20006)); });
+
+        std::this_thread::sleep_for(delay);
+        check(!owned[0] && !owned[1] && !owned[2], __LINE__);
+
+        locks.unlock_all();
+        check(!locks && locks.size() == 0, __LINE__);
+
+        threads.clear();
+        check(owned[0] && owned[1] && owned[2], __LINE__);
+    }
+
+    {
+        {
+            typename Locker::lock_set locks;
+            locks.insert(locker_.lock_shared(0, 10));
+            locks.insert(locker_.lock_shared(0, 10));
+            locks.insert(locker_.lock_exclusive(10, 20));
+        }
+
+        // released when the set went out of scope
+        auto lock = locker_.lock_exclusive(0, 20);
+        check(bool(lock), __LINE__);
+    }
+}
+
+int main() {
+    run_test<locker>();
+    run_test<range_locker>();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
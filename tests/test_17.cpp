@@ -0,0 +1,78 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "sharded_locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks sharded_locker.
+
+    Intervals spanning several partitions conflict with the overlapping
+    intervals in every partition, a failed try_lock releases the pieces
+    it acquired, and threads locking disjoint and spanning intervals
+    still exclude each other.
+*/
+
+void run_test() {
+    // partitions of width 100
+    sharded_locker locker_(8, 800);
+    check(locker_.shard_of(99) == 0 && locker_.shard_of(100) == 1 && locker_.shard_of(10'000) == 7, __LINE__);
+
+    {
+        auto lock = locker_.lock_exclusive(50, 150);
+        check(!locker_.try_lock_shared(60, 70), __LINE__);
+        check(!locker_.try_lock_shared(140, 160), __LINE__);
+        check(bool(locker_.try_lock_exclusive(150, 250)), __LINE__);
+
+        // shared across partitions
+        auto shared = lock.downgrade();
+        check(bool(locker_.try_lock_shared(0, 200)), __LINE__);
+        check(!locker_.try_lock_exclusive(149, 150), __LINE__);
+
+        lock = shared.upgrade();
+        check(!locker_.try_lock_shared(0, 200), __LINE__);
+    }
+
+    {
+        // a piece in partition 2 is taken, the pieces in partitions 0 and 1 are given back
+        auto lock = locker_.lock_shared(250, 260);
+        check(!locker_.try_lock_exclusive(0, 400), __LINE__);
+        check(bool(locker_.try_lock_exclusive(0, 250)), __LINE__);
+
+        // wider than a partition, up to the last (unbounded) partition
+        lock.unlock();
+        auto wide = locker_.lock_exclusive(10, 100'000);
+        check(!locker_.try_lock_shared(450, 451), __LINE__);
+        check(!locker_.try_lock_shared(50'000, 50'001), __LINE__);
+        check(bool(locker_.try_lock_shared(0, 10)), __LINE__);
+    }
+
+    {
+        std::size_t counter = 0;
+        std::vector<std::jthread> threads;
+
+        for (std::size_t t = 0; t < 8; ++t) {
+            threads.emplace_back([&, t]() {
+                for (std::size_t i = 0; i < 1000; ++i) {
+                    // every other lock spans all the partitions
+                    auto lock = i % 2 ? locker_.lock_exclusive(t * 100, t * 100 + 10) : locker_.lock_exclusive(0, 800);
+                    if (i % 2 == 0) {
+                        std::size_t value = counter;
+                        std::this_thread::yield();
+                        counter = value + 1;
+                    }
+                }
+            });
+        }
+
+        threads.clear();
+        check(counter == 8 * 500, __LINE__);
+    }
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "sharded_locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the adaptive mode of sharded_locker.
+
+    Under a skewed load the boundaries move towards the busy partition,
+    never through a held interval. The locks held while their range
+    migrates still exclude and are released correctly, and a thread
+    waiting in the migrated range gets its lock from the neighbour. The
+    locker waits for the locks handed over to a neighbour before it frees
+    the partitions.
+*/
+
+void run_test() {
+    using namespace std::chrono_literals;
+    auto delay = 100ms;
+
+    // partitions of width 1000
+    sharded_locker locker_(4, 4000, sharding::adaptive);
+    check((locker_.boundaries() == std::vector<std::size_t>{0, 1000, 2000, 3000}), __LINE__);
+
+    // held across the migration, the boundary can not go through (500, 720)
+    auto held = locker_.lock_exclusive(500, 720);
+    auto shared = locker_.lock_shared(100, 110);
+
+    // waits in partition 0 while its range migrates
+    std::atomic<bool> owned{false};
+    std::jthread waiter([&]() {
+        auto lock = locker_.lock_exclusive(700, 710);
+        owned = true;
+    });
+    std::this_thread::sleep_for(delay);
+
+    // all the load in partition 0
+    for (std::size_t i = 0; i < 10 * sharded_locker::rebalance_interval; ++i) {
+        auto lock = locker_.lock_exclusive(i % 100, i % 100 + 1);
+    }
+
+    auto bounds = locker_.boundaries();
+    check(bounds[1] < 1000, __LINE__);
+    check(!(bounds[1] > 500 && bounds[1] < 720), __LINE__);
+    for (std::size_t i = 1; i < bounds.size(); ++i) {
+        check(bounds[i - 1] <= bounds[i], __LINE__);
+    }
+
+    // the held locks still exclude, wherever they are now
+    check(!locker_.try_lock_shared(510, 511), __LINE__);
+    check(!locker_.try_lock_exclusive(105, 106), __LINE__);
+    check(bool(locker_.try_lock_shared(105, 106)), __LINE__);
+    check(!owned, __LINE__);
+
+    held.unlock();
+    shared.unlock();
+    waiter.join();
+    check(owned, __LINE__);
+    check(bool(locker_.try_lock_exclusive(0, 4000)), __LINE__);
+
+    {
+        // threads hammering one spot while others span the whole key space
+        std::size_t counter = 0;
+        std::vector<std::jthread> threads;
+
+        for (std::size_t t = 0; t < 8; ++t) {
+            threads.emplace_back([&, t]() {
+                for (std::size_t i = 0; i < 2000; ++i) {
+                    auto lock = i % 4 ? locker_.lock_exclusive(3000 + t * 10 + i % 10, 3001 + t * 10 + i % 10) : locker_.lock_exclusive(0, 4000);
+                    if (i % 4 == 0) {
+                        std::size_t value = counter;
+                        std::this_thread::yield();
+                        counter = value + 1;
+                    }
+                }
+            });
+        }
+
+        threads.clear();
+        check(counter == 8 * 500, __LINE__);
+
+        // the partitions squeezed to the left by the first load moved back towards the hot spot
+        check(locker_.boundaries()[3] > 1000, __LINE__);
+    }
+
+    {
+        // a lock handed over to the neighbour is released while the locker is being destroyed
+        std::jthread releaser;
+        {
+            sharded_locker other(2, 2000, sharding::adaptive);
+            auto lock = other.lock_exclusive(1010, 1011);
+            for (std::size_t i = 0; i < 5000; ++i) {
+                auto reader = other.lock_shared(1020, 1100);
+            }
+            check(other.shard_of(1010) == 0, __LINE__);
+
+            releaser = std::jthread([lock = std::move(lock)]() mutable {
+                std::this_thread::sleep_for(300ms);
+                lock.unlock();
+            });
+        }
+    }
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
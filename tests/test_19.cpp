@@ -0,0 +1,126 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "numa_locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks numa_locker and its parts.
+
+    numa_topology parses a fake /sys/devices/system/node (nodes without
+    CPUs are left out) and falls back to a single node without it.
+    cohort_mutex excludes with a single and with several nodes, also
+    under a condition variable, and numa_locker works like a sharded
+    locker on this machine, whatever its topology is (with a single
+    partition on a single node).
+*/
+
+void write_node(const std::filesystem::path &root, const char *name, const char *cpulist) {
+    std::filesystem::create_directories(root / name);
+    std::ofstream(root / name / "cpulist") << cpulist << "\n";
+}
+
+// Every thread increments the counter 1000 times under the mutex
+template<class Mutex>
+void check_exclusion(Mutex &mutex, std::size_t line) {
+    std::size_t counter = 0;
+    std::vector<std::jthread> threads;
+
+    for (std::size_t t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            for (std::size_t i = 0; i < 1000; ++i) {
+                std::unique_lock lock(mutex);
+                std::size_t value = counter;
+                if (i % 100 == 0)
+                    std::this_thread::yield();
+                counter = value + 1;
+            }
+        });
+    }
+
+    threads.clear();
+    check(counter == 8 * 1000, line);
+}
+
+void run_test() {
+    auto root = std::filesystem::temp_directory_path() / "interval_lock_test_19";
+    std::filesystem::remove_all(root);
+
+    write_node(root, "node0", "0-1,4");
+    write_node(root, "node1", "");
+    write_node(root, "node2", "2-3");
+    write_node(root, "node10", "5");
+    write_node(root, "cpu0", "6");
+
+    {
+        numa_topology topology(root);
+        check(topology.node_count() == 3, __LINE__);
+        check((topology.cpus(0) == std::vector<unsigned>{0, 1, 4}), __LINE__);
+        check((topology.cpus(1) == std::vector<unsigned>{2, 3}), __LINE__);
+        check((topology.cpus(2) == std::vector<unsigned>{5}), __LINE__);
+        check(topology.node_of(4) == 0 && topology.node_of(3) == 1 && topology.node_of(5) == 2, __LINE__);
+        check(topology.current_node() < 3, __LINE__);
+
+        cohort_mutex mutex(topology);
+        check_exclusion(mutex, __LINE__);
+        check(mutex.try_lock(), __LINE__);
+        std::jthread([&]() { check(!mutex.try_lock(), __LINE__); }).join();
+        mutex.unlock();
+    }
+
+    {
+        numa_topology topology(root / "missing");
+        check(topology.node_count() == 1 && topology.cpus(0).empty(), __LINE__);
+        check(topology.current_node() == 0, __LINE__);
+
+        cohort_mutex mutex(topology);
+        check_exclusion(mutex, __LINE__);
+    }
+
+    std::filesystem::remove_all(root);
+
+    {
+        numa_locker locker_(2, 800);
+        check(locker_.shard_count() == (locker_.node_count() == 1 ? 1 : 2 * locker_.node_count()), __LINE__);
+        check(locker_.home_of(0) == 0 && locker_.home_of(locker_.shard_count() - 1) == locker_.node_count() - 1, __LINE__);
+
+        auto lock = locker_.lock_exclusive(50, 650);
+        check(!locker_.try_lock_shared(600, 700), __LINE__);
+        check(bool(locker_.try_lock_shared(650, 700)), __LINE__);
+
+        auto shared = lock.downgrade();
+        check(bool(locker_.try_lock_shared(0, 800)), __LINE__);
+        check(!locker_.try_lock_exclusive(0, 100), __LINE__);
+        shared.unlock();
+
+        // waiters park on condition_variable_any with the cohort_mutex
+        std::size_t counter = 0;
+        std::vector<std::jthread> threads;
+        for (std::size_t t = 0; t < 8; ++t) {
+            threads.emplace_back([&, t]() {
+                for (std::size_t i = 0; i < 500; ++i) {
+                    if (i % 2) {
+                        auto lock = locker_.lock_shared(t * 100, t * 100 + 10);
+                    } else {
+                        auto lock = locker_.lock_exclusive(0, 800);
+                        std::size_t value = counter;
+                        std::this_thread::yield();
+                        counter = value + 1;
+                    }
+                }
+            });
+        }
+
+        threads.clear();
+        check(counter == 8 * 250, __LINE__);
+    }
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
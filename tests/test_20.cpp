@@ -0,0 +1,98 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "combining_locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks combining_locker.
+
+    Locks, try_locks, upgrades and downgrades give the same results as
+    with `locker`, a parked request is granted by the pass that releases
+    the conflicting lock, and threads still exclude each other with more
+    threads than slots (the releases then bypass the slots).
+*/
+
+void run_test(std::size_t slot_count) {
+    using namespace std::chrono_literals;
+    auto delay = 100ms;
+
+    combining_locker locker_(slot_count);
+
+    {
+        auto lock = locker_.lock_exclusive(0, 10);
+        check(!locker_.try_lock_shared(5, 15), __LINE__);
+        check(bool(locker_.try_lock_shared(10, 20)), __LINE__);
+
+        auto shared = lock.downgrade();
+        auto other = locker_.try_lock_shared(0, 10);
+        check(bool(other), __LINE__);
+        check(!locker_.try_lock_exclusive(9, 10), __LINE__);
+
+        // the upgrade is parked until `other` is released
+        std::atomic<bool> upgraded{false};
+        std::jthread thread([&]() {
+            lock = shared.upgrade();
+            upgraded = true;
+        });
+
+        std::this_thread::sleep_for(delay);
+        check(!upgraded, __LINE__);
+        other.unlock();
+        thread.join();
+        check(upgraded && bool(lock), __LINE__);
+        check(!locker_.try_lock_shared(0, 1), __LINE__);
+    }
+
+    {
+        // parked exclusive requests, granted one by one
+        auto lock = locker_.lock_shared(0, 100);
+        std::atomic<std::size_t> owned{0};
+        std::vector<std::jthread> threads;
+        for (std::size_t t = 0; t < 3; ++t) {
+            threads.emplace_back([&, t]() {
+                auto lock = locker_.lock_exclusive(t * 10, t * 10 + 10);
+                ++owned;
+            });
+        }
+
+        std::this_thread::sleep_for(delay);
+        check(owned == 0, __LINE__);
+        lock.unlock();
+        threads.clear();
+        check(owned == 3, __LINE__);
+    }
+
+    {
+        std::size_t counter = 0;
+        std::vector<std::jthread> threads;
+
+        for (std::size_t t = 0; t < 16; ++t) {
+            threads.emplace_back([&, t]() {
+                for (std::size_t i = 0; i < 1000; ++i) {
+                    if (i % 4) {
+                        auto lock = locker_.lock_shared(t * 10, t * 10 + 20);
+                    } else {
+                        auto lock = locker_.lock_exclusive(0, 1000);
+                        std::size_t value = counter;
+                        std::this_thread::yield();
+                        counter = value + 1;
+                    }
+                }
+            });
+        }
+
+        threads.clear();
+        check(counter == 16 * 250, __LINE__);
+    }
+}
+
+int main() {
+    run_test(combining_locker::default_slot_count);
+    run_test(4);
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks wait_strategy::spin_then_park.
+
+    Waiters get their locks after short holds (while spinning) as well as
+    after long ones (parked), upgrades and downgrades wait the same way,
+    and threads still exclude each other.
+*/
+
+template<class Locker>
+void run_test() {
+    using namespace std::chrono_literals;
+    auto delay = 100ms;
+
+    Locker locker_(wait_strategy::spin_then_park);
+
+    {
+        // a long hold, the waiter ends up parked
+        auto lock = locker_.lock_exclusive(0, 10);
+        std::atomic<bool> owned{false};
+        std::jthread thread([&]() {
+            auto lock = locker_.lock_shared(5, 15);
+            owned = true;
+        });
+
+        std::this_thread::sleep_for(delay);
+        check(!owned, __LINE__);
+        lock.unlock();
+        thread.join();
+        check(owned, __LINE__);
+    }
+
+    {
+        // the upgrade waits for the other shared lock
+        auto lock = locker_.lock_shared(0, 10);
+        auto other = locker_.lock_shared(0, 10);
+        std::jthread thread([&]() {
+            std::this_thread::sleep_for(delay);
+            other.unlock();
+        });
+
+        auto upgraded = lock.upgrade();
+        thread.join();
+        check(bool(upgraded) && !other, __LINE__);
+    }
+
+    {
+        // short holds, many threads
+        std::size_t counter = 0;
+        std::vector<std::jthread> threads;
+
+        for (std::size_t t = 0; t < 8; ++t) {
+            threads.emplace_back([&, t]() {
+                for (std::size_t i = 0; i < 2000; ++i) {
+                    if (i % 2) {
+                        auto lock = locker_.lock_shared(t * 10, t * 10 + 20);
+                    } else {
+                        auto lock = locker_.lock_exclusive(0, 100);
+                        ++counter;
+                    }
+                }
+            });
+        }
+
+        threads.clear();
+        check(counter == 8 * 1000, __LINE__);
+    }
+}
+
+int main() {
+    run_test<locker>();
+    run_test<basic_locker<writer_preferring>>();
+    run_test<basic_locker<fifo_per_overlap>>();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the direct handoff to blocked threads
+    (wait_strategy::handoff).
+
+    A release grants the lock to the parked waiters it unblocks (all the
+    shared ones at once), a timed waiter is handed its lock before the
+    deadline or leaves nothing behind after it, a stop request still
+    cancels a parked waiter, and the data written under the lock is seen
+    by the thread it was handed to.
+*/
+
+template<class Locker>
+void run_test() {
+    using namespace std::chrono_literals;
+    auto delay = 100ms;
+
+    Locker locker_(wait_strategy::handoff);
+
+    {
+        // the release hands the lock to all three shared waiters
+        auto lock = locker_.lock_exclusive(0, 100);
+        std::atomic<std::size_t> owned{0};
+        std::atomic<bool> done{false};
+        std::vector<std::jthread> threads;
+        for (std::size_t t = 0; t < 3; ++t) {
+            threads.emplace_back([&, t]() {
+                auto lock = locker_.lock_shared(t * 10, t * 10 + 50);
+                ++owned;
+                while (!done)
+                    std::this_thread::yield();
+            });
+        }
+
+        std::this_thread::sleep_for(delay);
+        check(owned == 0, __LINE__);
+        lock.unlock();
+        while (owned < 3)
+            std::this_thread::yield();
+        check(!locker_.try_lock_exclusive(40, 41), __LINE__);
+        done = true;
+        threads.clear();
+        check(bool(locker_.try_lock_exclusive(0, 100)), __LINE__);
+    }
+
+    {
+        // handed before the deadline
+        auto lock = locker_.lock_exclusive(0, 10);
+        std::jthread thread([&]() {
+            std::this_thread::sleep_for(delay);
+            lock.unlock();
+        });
+
+        auto other = locker_.try_lock_exclusive_for(5, 15, 10s);
+        check(bool(other), __LINE__);
+        thread.join();
+    }
+
+    {
+        // the deadline passes, the interval is not left locked
+        auto lock = locker_.lock_shared(0, 10);
+        check(!locker_.try_lock_exclusive_for(5, 15, delay), __LINE__);
+        lock.unlock();
+        check(bool(locker_.try_lock_exclusive(5, 15)), __LINE__);
+    }
+
+    {
+        // a stop request cancels the parked waiter, an unstopped one is handed its lock
+        auto lock = locker_.lock_exclusive(0, 10);
+        std::stop_source stopped;
+        std::stop_source running;
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> owned{false};
+        std::jthread first([&]() { cancelled = !locker_.lock_shared(0, 10, stopped.get_token()); });
+        std::jthread second([&]() { owned = bool(locker_.lock_shared(0, 10, running.get_token())); });
+
+        std::this_thread::sleep_for(delay);
+        stopped.request_stop();
+        first.join();
+        check(cancelled && !owned, __LINE__);
+        lock.unlock();
+        second.join();
+        check(owned, __LINE__);
+    }
+
+    {
+        // every exclusive holder sees what the previous one wrote
+        std::size_t counter = 0;
+        std::vector<std::jthread> threads;
+
+        for (std::size_t t = 0; t < 8; ++t) {
+            threads.emplace_back([&, t]() {
+                for (std::size_t i = 0; i < 1000; ++i) {
+                    if (i % 2) {
+                        auto lock = locker_.lock_shared(t * 10, t * 10 + 20);
+                    } else {
+                        auto lock = locker_.lock_exclusive(0, 100);
+                        std::size_t value = counter;
+                        if (i % 100 == 0)
+                            std::this_thread::yield();
+                        counter = value + 1;
+                    }
+                }
+            });
+        }
+
+        threads.clear();
+        check(counter == 8 * 500, __LINE__);
+    }
+}
+
+int main() {
+    run_test<locker>();
+    run_test<basic_locker<writer_preferring>>();
+    run_test<basic_locker<fifo_per_overlap>>();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
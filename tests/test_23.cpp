@@ -0,0 +1,118 @@
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the optimistic reads.
+
+    A token is empty while an exclusive lock over the range is held (also
+    one taken before the first read_version()), validate() fails after an
+    overlapping exclusive lock, upgrade or downgrade and passes after shared
+    locks and exclusive locks in other stripes, and the readers never
+    validate a half-written pair of values.
+*/
+
+template<class Locker>
+void run_test() {
+    Locker locker_;
+    constexpr std::size_t far = 5 << Locker::version_stripe_shift;
+
+    {
+        // held before the stripes exist
+        auto lock = locker_.lock_exclusive(0, 10);
+        check(!locker_.read_version(5, 15), __LINE__);
+        check(!locker_.validate(locker_.read_version(5, 15)), __LINE__);
+
+        auto token = locker_.read_version(far, far + 10);
+        check(bool(token) && locker_.validate(token), __LINE__);
+    }
+
+    {
+        auto token = locker_.read_version(0, 10);
+        check(bool(token) && locker_.validate(token), __LINE__);
+
+        // shared locks and exclusive locks elsewhere do not matter
+        locker_.lock_shared(0, 10).unlock();
+        locker_.lock_exclusive(far, far + 10).unlock();
+        check(locker_.validate(token), __LINE__);
+
+        locker_.lock_exclusive(9, 20).unlock();
+        check(!locker_.validate(token), __LINE__);
+    }
+
+    {
+        auto shared = locker_.lock_shared(0, 10);
+        auto token = locker_.read_version(0, 10);
+        check(bool(token), __LINE__);
+
+        auto exclusive = shared.upgrade();
+        check(!locker_.validate(token), __LINE__);
+        check(!locker_.read_version(0, 10), __LINE__);
+
+        shared = exclusive.downgrade();
+        token = locker_.read_version(0, 10);
+        check(bool(token) && locker_.validate(token), __LINE__);
+    }
+
+    {
+        // covering more keys than all the stripes
+        auto token = locker_.read_version(0, 1'000'000);
+        check(bool(token), __LINE__);
+        locker_.lock_exclusive(far, far + 1).unlock();
+        check(!locker_.validate(token), __LINE__);
+    }
+
+    {
+        // a writer keeps first == second under the exclusive lock
+        std::atomic<std::size_t> first{0};
+        std::atomic<std::size_t> second{0};
+        std::atomic<bool> done{false};
+        std::atomic<std::size_t> validated{0};
+
+        std::jthread writer([&]() {
+            for (std::size_t i = 1; i <= 2000; ++i) {
+                auto lock = locker_.lock_exclusive(100, 110);
+                first.store(i, std::memory_order_relaxed);
+                if (i % 10 == 0)
+                    std::this_thread::yield();
+                second.store(i, std::memory_order_relaxed);
+            }
+            done = true;
+        });
+
+        std::vector<std::jthread> readers;
+        for (std::size_t t = 0; t < 4; ++t) {
+            readers.emplace_back([&]() {
+                // one more read once the writer is done, it always validates
+                for (bool last = false; !last;) {
+                    last = done;
+                    auto token = locker_.read_version(100, 110);
+                    std::size_t a = first.load(std::memory_order_relaxed);
+                    std::size_t b = second.load(std::memory_order_relaxed);
+                    if (locker_.validate(token)) {
+                        check(a == b, __LINE__);
+                        ++validated;
+                    }
+                }
+            });
+        }
+
+        writer.join();
+        readers.clear();
+        check(validated > 0, __LINE__);
+
+        auto token = locker_.read_version(100, 110);
+        check(locker_.validate(token) && first == 2000 && second == 2000, __LINE__);
+    }
+}
+
+int main() {
+    run_test<locker>();
+    run_test<basic_locker<fifo_per_overlap>>();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
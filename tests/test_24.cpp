@@ -0,0 +1,130 @@
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the biased readers.
+
+    An interval locked shared promote_threshold times becomes hot, an
+    exclusive request, an upgrade or a lock released by another thread
+    revokes the bias (and the biased readers still count), a lock_set
+    releases biased locks, and readers on the biased path exclude a writer
+    overlapping the hot interval.
+*/
+
+template<class Locker>
+void make_hot(Locker &locker_, std::size_t b, std::size_t e) {
+    for (std::size_t i = 0; i < Locker::promote_threshold; ++i)
+        locker_.lock_shared(b, e).unlock();
+}
+
+template<class Locker>
+void run_test() {
+    Locker locker_;
+
+    {
+        make_hot(locker_, 0, 10);
+        check(locker_.is_biased(0, 10) && !locker_.is_biased(0, 11), __LINE__);
+
+        // nobody holds it, the revocation leaves nothing behind
+        check(bool(locker_.try_lock_exclusive(5, 6)), __LINE__);
+        check(!locker_.is_biased(0, 10), __LINE__);
+    }
+
+    {
+        make_hot(locker_, 0, 10);
+        auto first = locker_.lock_shared(0, 10);
+        auto second = locker_.lock_shared(0, 10);
+        check(locker_.is_biased(0, 10), __LINE__);
+
+        // the revocation counts both readers
+        check(!locker_.try_lock_exclusive(9, 20), __LINE__);
+        check(!locker_.is_biased(0, 10), __LINE__);
+        first.unlock();
+        check(!locker_.try_lock_exclusive(9, 20), __LINE__);
+        second.unlock();
+        check(bool(locker_.try_lock_exclusive(9, 20)), __LINE__);
+    }
+
+    {
+        // released by another thread (which revokes the bias, unless its slot happens to be ours)
+        make_hot(locker_, 20, 30);
+        auto lock = locker_.lock_shared(20, 30);
+        std::jthread([&]() { lock.unlock(); }).join();
+        check(bool(locker_.try_lock_exclusive(20, 30)), __LINE__);
+    }
+
+    {
+        // an upgrade waits for the other biased reader
+        make_hot(locker_, 40, 50);
+        auto lock = locker_.lock_shared(40, 50);
+        auto other = locker_.lock_shared(40, 50);
+        std::jthread thread([&]() { other.unlock(); });
+
+        auto upgraded = lock.upgrade();
+        thread.join();
+        check(bool(upgraded) && !locker_.try_lock_shared(45, 46), __LINE__);
+    }
+
+    {
+        make_hot(locker_, 60, 70);
+        {
+            typename Locker::lock_set locks;
+            locks.insert(locker_.lock_shared(60, 70));
+            locks.insert(locker_.lock_shared(60, 70));
+            locks.insert(locker_.lock_exclusive(80, 90));
+            check(locker_.is_biased(60, 70), __LINE__);
+        }
+        check(bool(locker_.try_lock_exclusive(60, 90)), __LINE__);
+    }
+
+    {
+        // readers of the hot interval never see the writer's flag set
+        make_hot(locker_, 100, 110);
+        std::atomic<bool> writing{false};
+        std::atomic<bool> done{false};
+        std::vector<std::jthread> threads;
+
+        for (std::size_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&]() {
+                while (!done) {
+                    {
+                        auto lock = locker_.lock_shared(100, 110);
+                        check(!writing, __LINE__);
+                    }
+                    std::this_thread::yield();
+                }
+            });
+        }
+
+        for (std::size_t i = 0; i < 50; ++i) {
+            {
+                auto lock = locker_.lock_exclusive(105, 115);
+                writing = true;
+                std::this_thread::yield();
+                writing = false;
+            }
+            std::this_thread::yield();
+        }
+
+        done = true;
+        threads.clear();
+        check(bool(locker_.try_lock_exclusive(100, 115)), __LINE__);
+    }
+
+    // destroyed with a hot interval
+    make_hot(locker_, 200, 210);
+    check(locker_.is_biased(200, 210), __LINE__);
+}
+
+int main() {
+    run_test<locker>();
+    run_test<basic_locker<writer_preferring>>();
+    run_test<basic_locker<fifo_per_overlap>>();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
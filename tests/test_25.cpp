@@ -0,0 +1,198 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the dedicated locks of hot intervals.
+
+    An interval locked promote_threshold times with the same bounds, once
+    exclusive, gets a dedicated lock: its shared and exclusive locks exclude
+    each other without demoting it, while an overlapping request, a timed
+    wait, an upgrade or a downgrade demotes it (its holders still count),
+    and so does a lack of use. Blocked lock_shared/lock_exclusive calls wait
+    on the dedicated lock, and the writers still fail the optimistic reads.
+*/
+
+template<class Locker>
+void make_dedicated(Locker &locker_, std::size_t b, std::size_t e) {
+    locker_.lock_exclusive(b, e).unlock();
+    for (std::size_t i = 1; i < Locker::promote_threshold; ++i)
+        locker_.lock_shared(b, e).unlock();
+}
+
+template<class Locker>
+void run_test() {
+    using namespace std::chrono_literals;
+
+    Locker locker_;
+
+    {
+        make_dedicated(locker_, 0, 10);
+        check(locker_.is_dedicated(0, 10) && !locker_.is_biased(0, 10), __LINE__);
+
+        // readers and the writer exclude each other on the dedicated lock
+        auto first = locker_.lock_shared(0, 10);
+        auto second = locker_.lock_shared(0, 10);
+        check(!locker_.try_lock_exclusive(0, 10), __LINE__);
+        first.unlock();
+        second.unlock();
+
+        auto exclusive = locker_.lock_exclusive(0, 10);
+        check(!locker_.try_lock_shared(0, 10) && !locker_.try_lock_exclusive(0, 10), __LINE__);
+        exclusive.unlock();
+        check(locker_.is_dedicated(0, 10), __LINE__);
+
+        // an overlapping request demotes it, both readers still count
+        first = locker_.lock_shared(0, 10);
+        second = locker_.lock_shared(0, 10);
+        check(!locker_.try_lock_exclusive(5, 15), __LINE__);
+        check(!locker_.is_dedicated(0, 10), __LINE__);
+        first.unlock();
+        check(!locker_.try_lock_exclusive(5, 15), __LINE__);
+        second.unlock();
+        check(bool(locker_.try_lock_exclusive(5, 15)), __LINE__);
+    }
+
+    {
+        // the writer becomes an exclusive lock in the tree
+        make_dedicated(locker_, 20, 30);
+        auto lock = locker_.lock_exclusive(20, 30);
+        check(!locker_.try_lock_shared(25, 26), __LINE__);
+        check(!locker_.is_dedicated(20, 30), __LINE__);
+        lock.unlock();
+        check(bool(locker_.try_lock_shared(25, 26)), __LINE__);
+    }
+
+    {
+        // a timed request that has to wait demotes it
+        make_dedicated(locker_, 40, 50);
+        auto lock = locker_.lock_exclusive(40, 50);
+        check(!locker_.try_lock_shared_for(40, 50, 10ms), __LINE__);
+        check(!locker_.is_dedicated(40, 50), __LINE__);
+    }
+
+    {
+        // upgrade of a dedicated reader, downgrade of a dedicated writer
+        make_dedicated(locker_, 60, 70);
+        auto lock = locker_.lock_shared(60, 70);
+        auto other = locker_.lock_shared(60, 70);
+        std::jthread thread([&]() {
+            std::this_thread::sleep_for(10ms);
+            other.unlock();
+        });
+
+        auto upgraded = lock.upgrade();
+        thread.join();
+        check(bool(upgraded) && !locker_.try_lock_shared(65, 66), __LINE__);
+        upgraded.unlock();
+
+        make_dedicated(locker_, 60, 70);
+        auto downgraded = locker_.lock_exclusive(60, 70).downgrade();
+        check(!locker_.is_dedicated(60, 70), __LINE__);
+        check(bool(locker_.try_lock_shared(65, 66)) && !locker_.try_lock_exclusive(65, 66), __LINE__);
+    }
+
+    {
+        make_dedicated(locker_, 80, 90);
+        {
+            typename Locker::lock_set locks;
+            locks.insert(locker_.lock_shared(80, 90));
+            locks.insert(locker_.lock_shared(80, 90));
+            locks.insert(locker_.lock_exclusive(100, 110));
+            check(locker_.is_dedicated(80, 90), __LINE__);
+        }
+        check(locker_.is_dedicated(80, 90), __LINE__);
+        {
+            typename Locker::lock_set locks;
+            locks.insert(locker_.lock_exclusive(80, 90));
+        }
+        check(bool(locker_.try_lock_exclusive(80, 110)), __LINE__);
+    }
+
+    {
+        // unused for demote_interval locks through the mutex
+        make_dedicated(locker_, 120, 130);
+        for (std::size_t i = 0; i < Locker::demote_interval; ++i)
+            locker_.lock_shared(1000 + i % 100, 2000).unlock();
+        check(!locker_.is_dedicated(120, 130), __LINE__);
+    }
+
+    {
+        // blocked callers wait on the dedicated lock, every writer sees what the previous one wrote
+        make_dedicated(locker_, 140, 150);
+        auto lock = locker_.lock_exclusive(140, 150);
+        std::atomic<bool> owned{false};
+        std::jthread reader([&]() { owned = bool(locker_.lock_shared(140, 150)); });
+
+        std::this_thread::sleep_for(10ms);
+        check(!owned && locker_.is_dedicated(140, 150), __LINE__);
+        lock.unlock();
+        reader.join();
+        check(owned, __LINE__);
+
+        std::size_t counter = 0;
+        std::atomic<bool> writing{false};
+        std::vector<std::jthread> threads;
+        for (std::size_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t]() {
+                for (std::size_t i = 0; i < 2000; ++i) {
+                    if (i % 3) {
+                        auto lock = locker_.lock_shared(140, 150);
+                        check(!writing, __LINE__);
+                    } else {
+                        auto lock = locker_.lock_exclusive(140, 150);
+                        writing = true;
+                        std::size_t value = counter;
+                        if (i % 64 == 0)
+                            std::this_thread::yield();
+                        counter = value + 1;
+                        writing = false;
+                    }
+
+                    // now and then an overlapping lock demotes it
+                    if (t == 0 && i % 500 == 0)
+                        locker_.lock_shared(145, 146).unlock();
+                }
+            });
+        }
+
+        threads.clear();
+        check(counter == 4 * 667, __LINE__);
+    }
+
+    {
+        // the stripes appear while a dedicated writer holds its lock, then the writers count on the dedicated path
+        make_dedicated(locker_, 160, 170);
+        auto lock = locker_.lock_exclusive(160, 170);
+        check(!locker_.read_version(160, 170), __LINE__);
+        lock.unlock();
+
+        auto token = locker_.read_version(160, 170);
+        check(bool(token), __LINE__);
+        make_dedicated(locker_, 160, 170);
+        check(!locker_.validate(token), __LINE__);
+
+        token = locker_.read_version(160, 170);
+        lock = locker_.lock_exclusive(160, 170);
+        check(locker_.is_dedicated(160, 170) && !locker_.read_version(160, 170), __LINE__);
+        lock.unlock();
+        check(!locker_.validate(token) && locker_.validate(locker_.read_version(160, 170)), __LINE__);
+    }
+
+    // destroyed with a dedicated interval
+    make_dedicated(locker_, 200, 210);
+    check(locker_.is_dedicated(200, 210), __LINE__);
+}
+
+int main() {
+    run_test<locker>();
+    run_test<basic_locker<writer_preferring>>();
+    run_test<basic_locker<fifo_per_overlap>>();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the intent and update modes.
+
+    The compatibility matrix is symmetric, intent locks over a whole range
+    let shared, exclusive and update locks on its parts proceed concurrently
+    while they exclude the conflicting locks over the whole range or
+    partially overlapping it (held or requested later, in both directions),
+    a blocked intent request is woken up by a release, update locks upgraded
+    by several threads neither deadlock nor lose an update, a request waiting
+    behind an intent request it is below proceeds once that one is granted
+    (with every fairness policy), and an intent
+    request keeps the dedicated locks below it.
+*/
+
+constexpr lock_mode modes[] = {lock_mode::intent_shared, lock_mode::intent_exclusive, lock_mode::shared,
+                               lock_mode::shared_intent_exclusive, lock_mode::update, lock_mode::exclusive};
+
+template<class Locker>
+void run_test() {
+    using namespace std::chrono_literals;
+
+    Locker locker_;
+
+    for (lock_mode a : modes)
+        for (lock_mode b : modes)
+            check(lock_modes_compatible(a, b) == lock_modes_compatible(b, a), __LINE__);
+
+    {
+        // a scan and an update of two parts of the file
+        auto scan = locker_.lock_intent(0, 1000, lock_mode::intent_shared);
+        auto update = locker_.lock_intent(0, 1000, lock_mode::intent_exclusive);
+        check(scan.mode() == lock_mode::intent_shared && update.mode() == lock_mode::intent_exclusive, __LINE__);
+
+        auto page = locker_.lock_shared(0, 100);
+        auto record = locker_.lock_exclusive(500, 510);
+
+        // the whole file can be neither read nor written
+        check(!locker_.try_lock_shared(0, 1000) && !locker_.try_lock_exclusive(0, 1000), __LINE__);
+        check(!locker_.try_lock_intent(0, 1000, lock_mode::update), __LINE__);
+        check(!locker_.try_lock_intent(200, 300, lock_mode::shared_intent_exclusive), __LINE__);
+        check(bool(locker_.try_lock_intent(200, 300, lock_mode::update)), __LINE__);
+        check(bool(locker_.try_lock_intent(200, 300, lock_mode::intent_exclusive)), __LINE__);
+
+        // but a lock partially overlapping an intent lock is not below it
+        check(!locker_.try_lock_shared(900, 1100), __LINE__);
+
+        update.unlock();
+        check(!locker_.try_lock_shared(0, 1000), __LINE__);
+        record.unlock();
+        check(bool(locker_.try_lock_shared(0, 1000)) && !locker_.try_lock_exclusive(0, 1000), __LINE__);
+    }
+
+    {
+        // the held locks exclude the intent requests as well
+        auto lock = locker_.lock_shared(0, 10);
+        check(!locker_.try_lock_intent(5, 15, lock_mode::intent_exclusive), __LINE__);
+        check(bool(locker_.try_lock_intent(5, 15, lock_mode::update)), __LINE__);
+        lock.unlock();
+
+        auto exclusive = locker_.lock_exclusive(0, 10);
+        check(!locker_.try_lock_intent(5, 15, lock_mode::intent_shared), __LINE__);
+        exclusive.unlock();
+
+        auto six = locker_.lock_intent(0, 10, lock_mode::shared_intent_exclusive);
+        check(bool(locker_.try_lock_intent(5, 15, lock_mode::intent_shared)), __LINE__);
+        check(!locker_.try_lock_intent(5, 15, lock_mode::intent_exclusive), __LINE__);
+        check(!locker_.try_lock_shared(5, 15), __LINE__);
+    }
+
+    {
+        // a release wakes up the blocked intent request
+        auto lock = locker_.lock_shared(0, 10);
+        std::atomic<bool> owned{false};
+        std::jthread thread([&]() {
+            auto intent = locker_.lock_intent(5, 15, lock_mode::intent_exclusive);
+            owned = true;
+        });
+
+        std::this_thread::sleep_for(10ms);
+        check(!owned, __LINE__);
+        lock.unlock();
+        thread.join();
+        check(owned, __LINE__);
+    }
+
+    {
+        // a request queued up behind an intent request it is below gets its lock once that one is granted (and does
+        // not hold back the intent holder's own locks): a writer inside a scan, and a reader inside an update
+        for (bool scan : {true, false}) {
+            auto lock = locker_.lock_exclusive(0, 100);
+            std::atomic<bool> inner_done{false};
+            std::jthread outer([&]() {
+                auto intent = locker_.lock_intent(0, 100, scan ? lock_mode::intent_shared : lock_mode::intent_exclusive);
+                bool owned = scan ? bool(locker_.try_lock_shared_for(10, 20, 2s)) : bool(locker_.try_lock_exclusive_for(10, 20, 2s));
+                check(owned, __LINE__);
+            });
+
+            std::this_thread::sleep_for(10ms);
+            std::jthread inner([&]() {
+                auto hold = [&](auto) {
+                    std::this_thread::sleep_for(10ms);
+                    inner_done = true;
+                };
+                if (scan)
+                    hold(locker_.lock_exclusive(10, 20));
+                else
+                    hold(locker_.lock_shared(10, 20));
+            });
+
+            std::this_thread::sleep_for(10ms);
+            lock.unlock();
+            outer.join();
+            inner.join();
+            check(inner_done, __LINE__);
+        }
+    }
+
+    {
+        // the upgrade waits for the readers, then the update lock is gone
+        auto update = locker_.lock_intent(0, 10, lock_mode::update);
+        auto reader = locker_.lock_shared(0, 10);
+        auto intent = locker_.lock_intent(0, 10, lock_mode::intent_shared);
+        std::jthread thread([&]() {
+            std::this_thread::sleep_for(10ms);
+            reader.unlock();
+            intent.unlock();
+        });
+
+        auto exclusive = update.upgrade();
+        thread.join();
+        check(bool(exclusive) && !update, __LINE__);
+        check(!locker_.try_lock_intent(5, 6, lock_mode::intent_shared), __LINE__);
+        exclusive.unlock();
+        check(bool(locker_.try_lock_intent(0, 10, lock_mode::update)), __LINE__);
+    }
+
+    {
+        // every thread reads, then writes: with update locks nobody deadlocks and no update is lost
+        std::size_t counter = 0;
+        std::vector<std::jthread> threads;
+        for (std::size_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t]() {
+                for (std::size_t i = 0; i < 500; ++i) {
+                    {
+                        auto update = locker_.lock_intent(t * 5, t * 5 + 50, lock_mode::update);
+                        std::size_t value = counter;
+                        if (i % 50 == 0)
+                            std::this_thread::yield();
+                        auto exclusive = update.upgrade();
+                        counter = value + 1;
+                    }
+
+                    if (i % 10 == 0) {
+                        auto reader = locker_.lock_shared(0, 100);
+                    }
+                }
+            });
+        }
+
+        threads.clear();
+        check(counter == 4 * 500, __LINE__);
+    }
+
+    {
+        // an intent request keeps a dedicated lock below it, and demotes one it is not above
+        locker_.lock_exclusive(200, 210).unlock();
+        for (std::size_t i = 1; i < Locker::promote_threshold; ++i)
+            locker_.lock_shared(200, 210).unlock();
+        check(locker_.is_dedicated(200, 210), __LINE__);
+
+        auto lock = locker_.lock_exclusive(200, 210);
+        auto intent = locker_.lock_intent(0, 1000, lock_mode::intent_shared);
+        check(locker_.is_dedicated(200, 210), __LINE__);
+        lock.unlock();
+        lock = locker_.lock_exclusive(200, 210);
+        check(locker_.is_dedicated(200, 210), __LINE__);
+
+        check(!locker_.try_lock_intent(205, 215, lock_mode::intent_shared), __LINE__);
+        check(!locker_.is_dedicated(200, 210), __LINE__);
+    }
+
+    // destroyed after the intent locks
+    auto lock = locker_.lock_intent(0, 10, lock_mode::intent_shared);
+}
+
+int main() {
+    run_test<locker>();
+    run_test<basic_locker<writer_preferring>>();
+    run_test<basic_locker<fifo_per_overlap>>();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the lock escalation.
+
+    A thread holding escalation_threshold exclusive locks in a region gets
+    a covering lock for them (an earlier one is merged into the next, and
+    one next to it grows), its later locks within the covering lock are
+    still checked against its own ones, the handles release, downgrade and are read optimistically as
+    before, and any other thread's request, a conflicting request of the
+    owner or another lock in between puts the locks back. The locks of two
+    threads taking turns are never escalated together. Threads locking
+    records in ascending order never see one locked twice.
+*/
+
+template<class Locker>
+void run_test() {
+    Locker locker_;
+
+    {
+        // adjacent locks, escalated once there are escalation_threshold of them, then the next ones join the covering lock
+        std::vector<typename Locker::exclusive_lock> locks;
+        for (std::size_t i = 0; i < Locker::escalation_threshold - 1; ++i)
+            locks.push_back(locker_.lock_exclusive(i, i + 1));
+        check(!locker_.is_escalated(0, 1), __LINE__);
+
+        for (std::size_t i = Locker::escalation_threshold - 1; i < 3 * Locker::escalation_threshold; ++i)
+            locks.push_back(locker_.lock_exclusive(i, i + 1));
+        check(locker_.is_escalated(0, 3 * Locker::escalation_threshold), __LINE__);
+
+        // another thread puts them back, then waits for the lock it asked for as usual
+        std::jthread([&]() {
+            check(!locker_.try_lock_shared(5, 6), __LINE__);
+        }).join();
+        check(!locker_.is_escalated(0, 1), __LINE__);
+
+        locks.erase(locks.begin(), locks.begin() + 10);
+        std::jthread([&]() {
+            check(bool(locker_.try_lock_exclusive(0, 10)) && !locker_.try_lock_exclusive(5, 15), __LINE__);
+        }).join();
+    }
+
+    check(bool(locker_.try_lock_exclusive(0, 1000)), __LINE__);
+
+    {
+        // locks with gaps in between, escalated twice: the owner locks a gap within the covering lock, but not what it holds
+        std::vector<typename Locker::exclusive_lock> locks;
+        for (std::size_t i = 0; i < 2 * Locker::escalation_threshold; ++i)
+            locks.push_back(locker_.lock_exclusive(2 * i, 2 * i + 1));
+        check(locker_.is_escalated(0, 3 * Locker::escalation_threshold), __LINE__);
+
+        auto gap = locker_.lock_exclusive(1, 2);
+        auto shared = locker_.lock_shared(3, 4);
+        auto other = locker_.lock_shared(3, 4);
+        check(locker_.is_escalated(1, 2) && !locker_.try_lock_exclusive(3, 4), __LINE__);
+        check(!locker_.is_escalated(1, 2), __LINE__);
+
+        // the handles work the same once put back
+        gap.unlock();
+        shared.unlock();
+        check(!locker_.try_lock_exclusive(3, 4), __LINE__);
+        other.unlock();
+        check(bool(locker_.try_lock_exclusive(1, 2)) && !locker_.try_lock_exclusive(0, 1), __LINE__);
+    }
+
+    {
+        // another lock in between keeps them in the tree
+        auto shared = locker_.lock_shared(101, 102);
+        std::vector<typename Locker::exclusive_lock> locks;
+        for (std::size_t i = 0; i < Locker::escalation_threshold; ++i)
+            locks.push_back(locker_.lock_exclusive(2 * i + 50, 2 * i + 51));
+        check(!locker_.is_escalated(50, 51), __LINE__);
+    }
+
+    {
+        // downgrade and optimistic reads of escalated locks (in every other stripe of versions, the covering lock is in all of them)
+        check(bool(locker_.read_version(0, 1)), __LINE__);
+
+        std::vector<typename Locker::exclusive_lock> locks;
+        for (std::size_t i = 0; i < Locker::escalation_threshold; ++i)
+            locks.push_back(locker_.lock_exclusive(128 * i, 128 * i + 1));
+        check(locker_.is_escalated(0, 1), __LINE__);
+        check(!locker_.read_version(0, 1) && !locker_.read_version(64, 65), __LINE__);
+
+        auto shared = locks[0].downgrade();
+        check(!locker_.is_escalated(0, 1), __LINE__);
+        check(bool(locker_.read_version(64, 65)) && !locker_.read_version(128, 129), __LINE__);
+        std::jthread([&]() {
+            check(bool(locker_.try_lock_shared(0, 1)) && !locker_.try_lock_exclusive(0, 1), __LINE__);
+        }).join();
+
+        auto token = locker_.read_version(64, 65);
+        locks.clear();
+        check(locker_.validate(token) && bool(locker_.read_version(128, 129)), __LINE__);
+    }
+
+    {
+        // two threads taking turns in one region, neither one is escalated
+        std::vector<typename Locker::exclusive_lock> locks[2];
+        std::atomic<std::size_t> turn = 0;
+        std::vector<std::jthread> threads;
+        for (std::size_t t = 0; t < 2; ++t) {
+            threads.emplace_back([&, t]() {
+                for (std::size_t i = 0; i < 2 * Locker::escalation_threshold; ++i) {
+                    std::size_t key = 2 * i + t;
+                    while (turn != key)
+                        std::this_thread::yield();
+                    locks[t].push_back(locker_.lock_exclusive(2000 + key, 2001 + key));
+                    turn++;
+                }
+            });
+        }
+
+        threads.clear();
+        check(!locker_.is_escalated(2000, 2001) && !locker_.is_escalated(2001, 2002), __LINE__);
+        locks[0].clear();
+        locks[1].clear();
+
+        // and a later thread (maybe with the same id) does not count the locks of a finished one
+        std::jthread([&]() {
+            locks[0].push_back(locker_.lock_exclusive(3000, 3001));
+        }).join();
+        std::jthread([&]() {
+            for (std::size_t i = 1; i < Locker::escalation_threshold; ++i)
+                locks[1].push_back(locker_.lock_exclusive(3000 + i, 3001 + i));
+        }).join();
+        check(!locker_.is_escalated(3000, 3001), __LINE__);
+    }
+
+    {
+        // every thread locks a hundred records in ascending order and updates them
+        std::vector<std::size_t> records(1000);
+        std::vector<std::jthread> threads;
+        for (std::size_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t]() {
+                std::mt19937 random(t);
+                for (std::size_t round = 0; round < 50; ++round) {
+                    std::size_t offset = random() % 1000;
+                    std::vector<std::size_t> keys;
+                    for (std::size_t j = 0; j < 100; ++j)
+                        keys.push_back((offset + j * 7) % 1000);
+                    std::sort(keys.begin(), keys.end());
+
+                    std::vector<typename Locker::exclusive_lock> locks;
+                    for (std::size_t key : keys) {
+                        locks.push_back(locker_.lock_exclusive(key, key + 1));
+                        if (key % 64 == 0)
+                            std::this_thread::yield();
+                    }
+                    for (std::size_t key : keys)
+                        records[key]++;
+
+                    // now and then a record is read in between
+                    if (round % 10 == 0) {
+                        std::size_t key = random() % 1000;
+                        auto lock = locker_.try_lock_shared(key, key + 1);
+                        check(!lock || std::find(keys.begin(), keys.end(), key) == keys.end(), __LINE__);
+                    }
+                }
+            });
+        }
+
+        threads.clear();
+        std::size_t sum = 0;
+        for (std::size_t count : records)
+            sum += count;
+        check(sum == 4 * 50 * 100, __LINE__);
+    }
+
+    check(bool(locker_.try_lock_exclusive(0, 1000)), __LINE__);
+}
+
+int main() {
+    run_test<locker>();
+    run_test<basic_locker<writer_preferring>>();
+    run_test<basic_locker<fifo_per_overlap>>();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
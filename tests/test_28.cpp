@@ -0,0 +1,195 @@
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the coalesced readers.
+
+    Shared locks next to each other or overlapping merge into one segment,
+    which excludes the exclusive requests over any of them and none in
+    between once it splits on a release (or shrinks to the locks left), a
+    reader on the bounds of a coalesced lock joins it, an upgrade puts its
+    lock back into the tree (and a waiting one is not coalesced again), and
+    intent requests see the coalesced locks one by one. Streaming readers
+    and writers never hold a record at once.
+*/
+
+template<class Locker>
+void run_test() {
+    Locker locker_;
+
+    {
+        // three readers next to each other, one segment
+        auto a = locker_.lock_shared(0, 10);
+        check(!locker_.is_coalesced(0, 10), __LINE__);
+        auto b = locker_.lock_shared(10, 20);
+        auto c = locker_.lock_shared(20, 30);
+        check(locker_.is_coalesced(0, 30), __LINE__);
+
+        std::jthread([&]() {
+            check(!locker_.try_lock_exclusive(5, 6) && !locker_.try_lock_exclusive(25, 35), __LINE__);
+            check(bool(locker_.try_lock_exclusive(30, 31)) && bool(locker_.try_lock_shared(0, 30)), __LINE__);
+        }).join();
+
+        // the release in the middle splits it
+        b.unlock();
+        check(locker_.is_coalesced(0, 10) && locker_.is_coalesced(20, 30), __LINE__);
+        check(!locker_.is_coalesced(0, 30) && !locker_.is_coalesced(10, 20), __LINE__);
+        std::jthread([&]() {
+            check(bool(locker_.try_lock_exclusive(10, 20)), __LINE__);
+            check(!locker_.try_lock_exclusive(9, 11) && !locker_.try_lock_exclusive(19, 21), __LINE__);
+        }).join();
+
+        // a reader on the same bounds counts in the coalesced lock
+        auto d = locker_.lock_shared(20, 30);
+        c.unlock();
+        check(locker_.is_coalesced(20, 30), __LINE__);
+        std::jthread([&]() {
+            check(!locker_.try_lock_exclusive(25, 26), __LINE__);
+        }).join();
+
+        d.unlock();
+        a.unlock();
+        check(!locker_.is_coalesced(0, 1) && !locker_.is_coalesced(20, 21), __LINE__);
+        check(bool(locker_.try_lock_exclusive(0, 30)), __LINE__);
+    }
+
+    {
+        // overlapping readers, the segment shrinks to the lock left
+        auto a = locker_.lock_shared(0, 10);
+        auto b = locker_.lock_shared(5, 15);
+        check(locker_.is_coalesced(0, 15), __LINE__);
+
+        a.unlock();
+        check(locker_.is_coalesced(5, 15) && !locker_.is_coalesced(0, 6), __LINE__);
+        std::jthread([&]() {
+            check(bool(locker_.try_lock_exclusive(0, 5)) && !locker_.try_lock_exclusive(4, 6), __LINE__);
+        }).join();
+    }
+
+    {
+        // the upgraded lock leaves the segment
+        auto a = locker_.lock_shared(40, 50);
+        auto b = locker_.lock_shared(50, 60);
+        check(locker_.is_coalesced(40, 60), __LINE__);
+
+        auto exclusive = a.upgrade();
+        check(bool(exclusive) && !locker_.is_coalesced(40, 50) && locker_.is_coalesced(50, 60), __LINE__);
+        std::jthread([&]() {
+            check(!locker_.try_lock_shared(45, 46) && bool(locker_.try_lock_shared(55, 56)), __LINE__);
+            check(!locker_.try_lock_exclusive(55, 56), __LINE__);
+        }).join();
+
+        // and an upgrade waits for the coalesced readers overlapping its lock
+        auto c = locker_.lock_shared(55, 65);
+        auto d = locker_.lock_shared(65, 75);
+        check(locker_.is_coalesced(50, 75), __LINE__);
+        auto timed = c.try_upgrade_for(std::chrono::milliseconds(10));
+        check(!timed && bool(c), __LINE__);
+        b.unlock();
+        check(bool(c.upgrade()) && locker_.is_coalesced(65, 75) && !locker_.is_coalesced(55, 75), __LINE__);
+    }
+
+    {
+        // a lock waiting for an upgrade stays out of the segment of a reader next to it
+        auto a = locker_.lock_shared(200, 210);
+        auto b = locker_.lock_shared(200, 210);
+
+        bool upgraded = false;
+        std::jthread upgrader([&]() {
+            upgraded = bool(a.try_upgrade_for(std::chrono::seconds(10)));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        auto c = locker_.lock_shared(210, 220);
+        check(!locker_.is_coalesced(200, 210), __LINE__);
+        b.unlock();
+        c.unlock();
+        upgrader.join();
+        check(upgraded, __LINE__);
+    }
+
+    {
+        // an intent lock above the coalesced readers, but not over a part of one
+        auto a = locker_.lock_shared(110, 120);
+        auto b = locker_.lock_shared(120, 130);
+        check(locker_.is_coalesced(110, 130), __LINE__);
+
+        check(bool(locker_.try_lock_intent(100, 200, lock_mode::intent_exclusive)), __LINE__);
+        check(!locker_.try_lock_intent(125, 200, lock_mode::intent_exclusive), __LINE__);
+        check(bool(locker_.try_lock_intent(125, 200, lock_mode::intent_shared)), __LINE__);
+    }
+
+    {
+        // readers streaming over the records, each one holding a window of them, and writers in between
+        constexpr std::size_t record_count = 1000;
+        std::vector<std::atomic<int>> readers(record_count);
+        std::vector<std::atomic<int>> writers(record_count);
+
+        std::vector<std::jthread> threads;
+        for (std::size_t t = 0; t < 2; ++t) {
+            threads.emplace_back([&, t]() {
+                std::deque<std::pair<std::size_t, typename Locker::shared_lock>> window;
+                auto release = [&]() {
+                    for (std::size_t k = window.front().first; k < window.front().first + 4; ++k)
+                        readers[k]--;
+                    window.pop_front();
+                };
+
+                for (std::size_t i = 0; i < 3000; ++i) {
+                    std::size_t b = (t * 500 + i * 4) % (record_count - 4);
+
+                    // a writer waiting for the window may hold the next records back, then the window goes first
+                    auto lock = locker_.try_lock_shared(b, b + 4);
+                    if (!lock) {
+                        while (!window.empty())
+                            release();
+                        lock = locker_.lock_shared(b, b + 4);
+                    }
+                    for (std::size_t k = b; k < b + 4; ++k) {
+                        readers[k]++;
+                        check(writers[k] == 0, __LINE__);
+                    }
+                    window.emplace_back(b, std::move(lock));
+
+                    if (window.size() > 16)
+                        release();
+                }
+
+                while (!window.empty())
+                    release();
+            });
+        }
+
+        for (std::size_t t = 0; t < 2; ++t) {
+            threads.emplace_back([&, t]() {
+                std::mt19937 random(t);
+                for (std::size_t i = 0; i < 2000; ++i) {
+                    std::size_t b = random() % (record_count - 3);
+                    auto lock = locker_.lock_exclusive(b, b + 3);
+                    for (std::size_t k = b; k < b + 3; ++k)
+                        check(writers[k]++ == 0 && readers[k] == 0, __LINE__);
+                    for (std::size_t k = b; k < b + 3; ++k)
+                        writers[k]--;
+                }
+            });
+        }
+    }
+
+    check(bool(locker_.try_lock_exclusive(0, 2000)), __LINE__);
+}
+
+int main() {
+    run_test<locker>();
+    run_test<basic_locker<writer_preferring>>();
+    run_test<basic_locker<fifo_per_overlap>>();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
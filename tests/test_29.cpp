@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <ranges>
+#include <vector>
+
+#include "interval_tree.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the lazy overlap view of the interval tree.
+
+    It is strictly single-threaded: the view is an input range and a view,
+    a range-for over it visits exactly the overlapping nodes, an empty
+    query gives an empty view and a visitor stops early when asked to.
+*/
+
+using tree = interval_tree<int>;
+
+static_assert(std::ranges::input_range<tree::overlap_view>);
+static_assert(std::ranges::view<tree::overlap_view>);
+
+void run_test() {
+    tree tree_;
+
+    for (std::size_t i = 0; i < 100; ++i)
+        tree_.emplace({i * 10, i * 10 + 15}, int(i));
+
+    {
+        // [95, 125) overlaps [80, 95), [90, 105), ..., [120, 135)
+        std::vector<int> seen;
+        for (auto *n : tree_.overlaps({95, 125}))
+            seen.push_back(n->value);
+
+        std::ranges::sort(seen);
+        check(seen == std::vector<int>{9, 10, 11, 12}, __LINE__);
+    }
+
+    {
+        // past the last interval there is nothing
+        auto view = tree_.overlaps({2000, 3000});
+        check(view.begin() == view.end(), __LINE__);
+    }
+
+    {
+        // the identity of the query is skipped on request
+        std::size_t count = 0;
+        for (auto *n : tree_.overlaps({100, 115}, true)) {
+            check(n->key != tree::key_type{100, 115}, __LINE__);
+            ++count;
+        }
+        check(count == 2, __LINE__);
+    }
+
+    {
+        // the visitor stops the traversal early
+        std::size_t count = 0;
+        bool finished = tree_.for_each_overlap({0, 1000}, [&](tree::node *) { return ++count < 3; });
+        check(!finished && count == 3, __LINE__);
+    }
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "interval_tree.hpp"
+#include "pool_allocator.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the pool allocator of the interval tree nodes.
+
+    It is strictly single-threaded and counts the allocations of the
+    global heap: a freed object is handed out again, reserve preallocates
+    (so the reserved allocations and a tree churning within its reserve
+    never touch the heap), and destroying a tree destroys its values and
+    gives all the memory of its pool back.
+*/
+
+static std::size_t heap_allocations = 0;
+static std::size_t heap_outstanding = 0;
+
+void *operator new(std::size_t size) {
+    ++heap_allocations;
+    ++heap_outstanding;
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    if (p != nullptr)
+        --heap_outstanding;
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+struct counted {
+    static inline std::size_t alive = 0;
+
+    counted() { ++alive; }
+    ~counted() { --alive; }
+
+    counted(const counted &) = delete;
+    counted &operator=(const counted &) = delete;
+};
+
+using tree = interval_tree<counted, pool_allocator<counted>>;
+
+void run_test() {
+    {
+        // a freed object is handed out again
+        pool_allocator<int> pool;
+        int *a = pool.allocate(1);
+        int *b = pool.allocate(1);
+        pool.deallocate(a, 1);
+        check(pool.allocate(1) == a, __LINE__);
+        pool.deallocate(b, 1);
+        check(pool.allocate(1) == b, __LINE__);
+    }
+
+    {
+        // the reserved allocations are served without the heap
+        pool_allocator<int> pool;
+        pool.reserve(1000);
+        check(pool.available() >= 1000, __LINE__);
+
+        std::vector<int *> objects;
+        objects.reserve(1000);
+
+        std::size_t before = heap_allocations;
+        for (std::size_t i = 0; i < 1000; ++i)
+            objects.push_back(pool.allocate(1));
+        check(heap_allocations == before, __LINE__);
+
+        for (int *p : objects)
+            pool.deallocate(p, 1);
+        check(pool.available() >= 1000, __LINE__);
+    }
+
+    std::size_t outstanding = heap_outstanding;
+
+    {
+        // a tree churning within its reserve does not touch the heap either
+        tree tree_;
+        tree_.reserve(500);
+
+        std::size_t before = heap_allocations;
+        for (std::size_t round = 0; round < 10; ++round) {
+            for (std::size_t i = 0; i < 500; ++i)
+                tree_.emplace({i * 10, i * 10 + 5});
+            check(counted::alive == 500, __LINE__);
+
+            for (std::size_t i = 0; i < 500; ++i)
+                tree_.erase({i * 10, i * 10 + 5});
+            check(counted::alive == 0 && tree_.empty(), __LINE__);
+        }
+        check(heap_allocations == before, __LINE__);
+
+        // the tree is destroyed with nodes in it
+        for (std::size_t i = 0; i < 2000; ++i)
+            tree_.emplace({i, i + 1});
+        check(counted::alive == 2000, __LINE__);
+    }
+
+    // ... which destroyed the values and gave the memory of the pool back
+    check(counted::alive == 0, __LINE__);
+    check(heap_outstanding == outstanding, __LINE__);
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
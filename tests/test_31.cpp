@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+
+#include "interval_tree.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the shape of the interval tree.
+
+    It is strictly single-threaded: random sequences of emplace and erase
+    (by key and by node) are mirrored in a std::map, and after every step
+    the tree holds exactly the keys of the map, is a binary search tree,
+    its parent links match the child links, it is AVL-balanced and the
+    heights and maximums of all the nodes are right.
+*/
+
+using tree = interval_tree<int>;
+using node = tree::node;
+
+// Checks the subtree of `n` and returns the number of its nodes
+std::size_t check_subtree(const node *n, const node *parent, const std::map<tree::key_type, int> &model) {
+    if (n == nullptr)
+        return 0;
+
+    check(n->parent == parent, __LINE__);
+    check(n->left == nullptr || n->left->key < n->key, __LINE__);
+    check(n->right == nullptr || n->key < n->right->key, __LINE__);
+
+    auto found = model.find(n->key);
+    check(found != model.end() && found->second == n->value, __LINE__);
+
+    std::size_t count = check_subtree(n->left, n, model) + check_subtree(n->right, n, model) + 1;
+
+    std::size_t left_height = n->left != nullptr ? n->left->height : 0;
+    std::size_t right_height = n->right != nullptr ? n->right->height : 0;
+    check(n->height == std::max(left_height, right_height) + 1, __LINE__);
+    check(std::max(left_height, right_height) - std::min(left_height, right_height) <= 1, __LINE__);
+
+    std::size_t maximum = n->key.second;
+    if (n->left != nullptr)
+        maximum = std::max(maximum, n->left->maximum);
+    if (n->right != nullptr)
+        maximum = std::max(maximum, n->right->maximum);
+    check(n->maximum == maximum, __LINE__);
+
+    return count;
+}
+
+void check_tree(tree &tree_, const std::map<tree::key_type, int> &model) {
+    const node *root = tree_.find_min();
+    while (root != nullptr && root->parent != nullptr)
+        root = root->parent;
+
+    check(check_subtree(root, nullptr, model) == model.size(), __LINE__);
+    check(tree_.empty() == model.empty(), __LINE__);
+}
+
+void run_test() {
+    std::mt19937_64 random(42);
+
+    for (std::size_t key_space : {64, 1000, 100000}) {
+        tree tree_;
+        std::map<tree::key_type, int> model;
+
+        for (std::size_t step = 0; step < 20000; ++step) {
+            std::size_t b = random() % key_space;
+            std::size_t e = b + 1 + random() % 50;
+            int value = int(step);
+
+            // grow for the first half, then shrink
+            bool grow = random() % 100 < (step < 10000 ? 70 : 30);
+
+            if (grow) {
+                auto [n, inserted] = tree_.emplace({b, e}, value);
+                check(inserted == model.emplace(tree::key_type{b, e}, value).second, __LINE__);
+                check(n->key == tree::key_type{b, e} && n->value == model[{b, e}], __LINE__);
+            }
+            else if (!model.empty()) {
+                // erase an existing key, by key or by node
+                auto it = model.lower_bound({b, e});
+                if (it == model.end())
+                    it = model.begin();
+
+                if (step % 2 == 0)
+                    tree_.erase(it->first);
+                else
+                    tree_.erase(tree_.find(it->first));
+                model.erase(it);
+            }
+
+            if (step % 100 == 0 || key_space == 64)
+                check_tree(tree_, model);
+        }
+
+        check_tree(tree_, model);
+
+        while (!model.empty()) {
+            tree_.erase(model.begin()->first);
+            model.erase(model.begin());
+            check_tree(tree_, model);
+        }
+    }
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
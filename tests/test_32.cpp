@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "interval_tree.hpp"
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks that the node handles stay valid.
+
+    It is strictly single-threaded: the nodes of the tree keep their
+    addresses while many other nodes are erased (and the tree rebalances),
+    and the shared and exclusive locks held meanwhile still upgrade,
+    downgrade and unlock their own intervals afterwards.
+*/
+
+using tree = interval_tree<int>;
+
+void run_test() {
+    {
+        // every tenth node is kept, all the others are erased in a random order
+        tree tree_;
+        std::vector<tree::node *> kept;
+        std::vector<tree::key_type> others;
+
+        for (std::size_t i = 0; i < 10000; ++i) {
+            auto [n, inserted] = tree_.emplace({i * 10, i * 10 + 15}, int(i));
+            if (i % 10 == 0)
+                kept.push_back(n);
+            else
+                others.push_back(n->key);
+        }
+
+        std::shuffle(others.begin(), others.end(), std::mt19937_64(42));
+        for (auto key : others)
+            tree_.erase(key);
+
+        for (std::size_t i = 0; i < kept.size(); ++i) {
+            check(kept[i]->key == tree::key_type{i * 100, i * 100 + 15} && kept[i]->value == int(i * 10), __LINE__);
+            check(tree_.find(kept[i]->key) == kept[i], __LINE__);
+        }
+
+        // erasing through the kept handles empties the tree
+        for (auto *n : kept)
+            tree_.erase(n);
+        check(tree_.empty(), __LINE__);
+    }
+
+    {
+        locker locker_;
+        std::vector<shared_lock> readers;
+        std::vector<exclusive_lock> writers;
+
+        // held locks, among many unrelated ones taken and dropped
+        for (std::size_t i = 0; i < 200; ++i) {
+            std::vector<exclusive_lock> churn;
+            for (std::size_t j = 0; j < 50; ++j)
+                churn.push_back(locker_.lock_exclusive(1'000'000 + (i * 50 + j) * 10, 1'000'000 + (i * 50 + j) * 10 + 5));
+
+            if (i % 2 == 0)
+                readers.push_back(locker_.lock_shared(i * 100, i * 100 + 50));
+            else
+                writers.push_back(locker_.lock_exclusive(i * 100, i * 100 + 50));
+
+            // dropped in a random order
+            std::shuffle(churn.begin(), churn.end(), std::mt19937_64(i));
+        }
+
+        for (std::size_t i = 0; i < 200; ++i)
+            check(!locker_.try_lock_exclusive(i * 100 + 10, i * 100 + 20), __LINE__);
+
+        // the readers upgrade and the writers downgrade their own intervals
+        std::vector<exclusive_lock> upgraded;
+        for (auto &reader : readers)
+            upgraded.push_back(reader.upgrade());
+
+        std::vector<shared_lock> downgraded;
+        for (auto &writer : writers)
+            downgraded.push_back(writer.downgrade());
+
+        for (std::size_t i = 0; i < 200; ++i) {
+            check(!locker_.try_lock_exclusive(i * 100 + 10, i * 100 + 20), __LINE__);
+            check(bool(locker_.try_lock_shared(i * 100 + 10, i * 100 + 20)) == (i % 2 == 1), __LINE__);
+        }
+
+        // then the handles unlock exactly their intervals
+        for (auto &lock : upgraded)
+            lock.unlock();
+        for (auto &lock : downgraded)
+            lock.unlock();
+
+        for (std::size_t i = 0; i < 200; ++i)
+            check(bool(locker_.try_lock_exclusive(i * 100, i * 100 + 50)), __LINE__);
+    }
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
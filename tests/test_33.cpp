@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+
+#include "interval_tree.hpp"
+#include "check.hpp"
+
+/*
+    This test checks the exclusive augmentation of the interval tree.
+
+    It is strictly single-threaded: random sequences of emplace, erase
+    (which rotate the tree) and exclusivity changes through refresh are
+    mirrored in a std::map. After every step each node's
+    exclusive_maximum is the largest end of an exclusive interval in its
+    subtree, and for random queries the pruned get_overlap_if finds an
+    overlapping exclusive interval exactly when a linear scan of the map
+    does (and the one it finds is exclusive and overlapping).
+*/
+
+struct info {
+    bool is_exclusive;
+};
+
+using tree = interval_tree<info>;
+using node = tree::node;
+
+bool overlaps(tree::key_type a, tree::key_type b) {
+    return a.first < b.second && b.first < a.second;
+}
+
+std::size_t check_subtree(const node *n) {
+    if (n == nullptr)
+        return 0;
+
+    std::size_t maximum = n->value.is_exclusive ? n->key.second : 0;
+    maximum = std::max({maximum, check_subtree(n->left), check_subtree(n->right)});
+    check(n->exclusive_maximum == maximum, __LINE__);
+
+    return maximum;
+}
+
+void check_tree(tree &tree_, const std::map<tree::key_type, bool> &model, std::mt19937_64 &random, std::size_t key_space) {
+    const node *root = tree_.find_min();
+    while (root != nullptr && root->parent != nullptr)
+        root = root->parent;
+    check_subtree(root);
+
+    for (std::size_t i = 0; i < 20; ++i) {
+        std::size_t b = random() % key_space;
+        tree::key_type query{b, b + 1 + random() % 100};
+
+        bool expected = std::any_of(model.begin(), model.end(), [&](const auto &entry) {
+            return entry.second && overlaps(entry.first, query);
+        });
+
+        const node *found = tree_.get_overlap_if(query, true);
+        check((found != tree_.end()) == expected, __LINE__);
+        check(found == tree_.end() || (found->value.is_exclusive && overlaps(found->key, query)), __LINE__);
+    }
+}
+
+void run_test() {
+    std::mt19937_64 random(7);
+
+    for (std::size_t key_space : {200, 5000}) {
+        tree tree_;
+        std::map<tree::key_type, bool> model;
+
+        for (std::size_t step = 0; step < 10000; ++step) {
+            std::size_t b = random() % key_space;
+            tree::key_type key{b, b + 1 + random() % 30};
+
+            // few exclusive intervals among many shared ones, grow for the first half, then shrink
+            bool is_exclusive = random() % 10 == 0;
+            std::size_t action = random() % 100;
+            std::size_t grow = step < 5000 ? 60 : 30;
+
+            if (action < grow) {
+                if (tree_.emplace(key, info{is_exclusive}).second)
+                    model.emplace(key, is_exclusive);
+            }
+            else if (!model.empty()) {
+                auto it = model.lower_bound(key);
+                if (it == model.end())
+                    it = model.begin();
+
+                if (action < grow + 20) {
+                    // an exclusive lock downgraded or a shared one upgraded
+                    node *n = tree_.find(it->first);
+                    n->value.is_exclusive = it->second = !it->second;
+                    tree_.refresh(n);
+                }
+                else {
+                    tree_.erase(it->first);
+                    model.erase(it);
+                }
+            }
+
+            check_tree(tree_, model, random, key_space + 50);
+        }
+    }
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "locker.hpp"
+#include "check.hpp"
+
+/*
+    This test checks that a release wakes up only the overlapping waiters.
+
+    The locker's mutex counts how often every waiting thread takes it.
+    Releasing an interval hands the lock to all the waiters overlapping it
+    (plain, lock_many and cancellable ones), while the waiters blocked
+    elsewhere stay parked: they do not take the mutex once until their
+    own interval is released.
+*/
+
+constexpr std::size_t thread_count = 6;
+
+// How often each waiting thread took the mutex
+std::atomic<std::size_t> acquisitions[thread_count];
+thread_local std::size_t thread_index = thread_count;
+
+class counting_mutex {
+public:
+    void lock() {
+        mtx_.lock();
+        count();
+    }
+
+    bool try_lock() {
+        if (!mtx_.try_lock())
+            return false;
+        count();
+        return true;
+    }
+
+    void unlock() {
+        mtx_.unlock();
+    }
+
+private:
+    static void count() {
+        if (thread_index < thread_count)
+            ++acquisitions[thread_index];
+    }
+
+    std::mutex mtx_;
+};
+
+using counting_locker = basic_locker<reader_preferring, counting_mutex>;
+
+void run_test() {
+    using namespace std::chrono_literals;
+
+    counting_locker locker_;
+    auto first = locker_.lock_exclusive(0, 100);
+    auto second = locker_.lock_exclusive(1000, 1100);
+
+    std::atomic<std::size_t> owned{0};
+    std::vector<std::jthread> threads;
+
+    // threads 0-2 wait for the first interval, 3-5 for the second one, each a plain, a lock_many and a cancellable waiter
+    for (std::size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t](std::stop_token token) {
+            thread_index = t;
+            std::size_t b = (t < 3 ? 0 : 1000) + (t % 3) * 20 + 10;
+
+            if (t % 3 == 0) {
+                auto lock = locker_.lock_exclusive(b, b + 10);
+                ++owned;
+            }
+            else if (t % 3 == 1) {
+                range_request request{b, b + 10, true};
+                auto locks = locker_.lock_many({&request, 1});
+                ++owned;
+            }
+            else {
+                auto lock = locker_.lock_shared(b, b + 10, token);
+                check(lock.owns_lock(), __LINE__);
+                ++owned;
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(100ms);
+    check(owned == 0, __LINE__);
+
+    std::size_t parked[thread_count];
+    for (std::size_t t = 0; t < thread_count; ++t)
+        parked[t] = acquisitions[t];
+
+    // all the waiters overlapping the first interval get their locks...
+    first.unlock();
+    while (owned < 3)
+        std::this_thread::yield();
+
+    // ... and the other ones were not even woken up
+    std::this_thread::sleep_for(50ms);
+    check(owned == 3, __LINE__);
+    for (std::size_t t = 3; t < thread_count; ++t)
+        check(acquisitions[t] == parked[t], __LINE__);
+
+    second.unlock();
+    threads.clear();
+    check(owned == thread_count, __LINE__);
+}
+
+int main() {
+    run_test();
+    std::cout << "OK" << std::endl;
+    return 0;
+}